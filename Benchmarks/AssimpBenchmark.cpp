@@ -0,0 +1,689 @@
+// Assimp extension benchmark.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+// Generates synthetic models in the formats registered by the
+// AssimpPlugin, loads each of them a number of times and writes the
+// timings of each load phase, throughput, heap usage and allocation
+// counts as JSON. Some models are also loaded with collision proxies
+// enabled, built on worker threads.
+//
+// usage: AssimpBenchmark [-r runs] [-s scale] [-d dir] [-o file] [-k]
+//
+//   -r runs   loads per model (default 3)
+//   -s scale  multiplies the size of the generated models (default 1)
+//   -d dir    directory for the generated models (default .)
+//   -o file   write the JSON report to file instead of stdout
+//   -k        keep the generated models
+
+#include <Resources/AssimpResource.h>
+#include <Resources/AssimpPLYStreamResource.h>
+#include <Resources/Exceptions.h>
+#include <Core/Mutex.h>
+#include <Utils/Timer.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <new>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace OpenEngine::Resources;
+using OpenEngine::Core::Mutex;
+using OpenEngine::Utils::Timer;
+using std::string;
+using std::vector;
+using std::ofstream;
+using std::ostream;
+using std::ostringstream;
+
+// Heap accounting. Every allocation through new is prefixed with its
+// size. The counters are guarded by a lock as collision proxies are
+// built on worker threads. The lock is created by main, allocations
+// before that are single threaded.
+static unsigned long allocCount = 0, allocBytes = 0;
+static unsigned long liveBytes = 0, peakBytes = 0;
+static Mutex* counterLock = NULL;
+static const size_t header = 16;
+
+void* operator new(size_t size) {
+    size_t* p = (size_t*)malloc(size + header);
+    if (!p) throw std::bad_alloc();
+    *p = size;
+    if (counterLock) counterLock->Lock();
+    allocCount++;
+    allocBytes += size;
+    liveBytes += size;
+    if (liveBytes > peakBytes) peakBytes = liveBytes;
+    if (counterLock) counterLock->Unlock();
+    return (char*)p + header;
+}
+
+void operator delete(void* ptr) throw() {
+    if (!ptr) return;
+    size_t* p = (size_t*)((char*)ptr - header);
+    if (counterLock) counterLock->Lock();
+    liveBytes -= *p;
+    if (counterLock) counterLock->Unlock();
+    free(p);
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete[](void* ptr) throw() {
+    operator delete(ptr);
+}
+
+/**
+ * Peak resident set size of the process in kilobytes.
+ */
+long PeakRSS() {
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return 0;
+}
+
+// ---------------------------------------------------------------
+// Model generators
+// ---------------------------------------------------------------
+
+/**
+ * Wavefront OBJ with a number of grid objects sharing materials.
+ */
+void WriteOBJ(string file, string mtl, unsigned int objects,
+              unsigned int grid, unsigned int materials) {
+    unsigned int o, i, j, base = 1;
+    ofstream m(mtl.c_str());
+    for (i = 0; i < materials; ++i) {
+        m << "newmtl mat" << i << "\n"
+          << "Kd " << (i % 3) / 2.0 << " " << (i % 5) / 4.0 << " 0.5\n"
+          << "Ks 0.5 0.5 0.5\n"
+          << "Ns " << 10 + i << "\n";
+    }
+
+    ofstream f(file.c_str());
+    f << "mtllib " << mtl.substr(mtl.find_last_of("/\\") + 1) << "\n";
+    for (o = 0; o < objects; ++o) {
+        f << "o object" << o << "\n"
+          << "usemtl mat" << o % materials << "\n";
+        for (i = 0; i < grid; ++i) {
+            for (j = 0; j < grid; ++j) {
+                float x = i / (float)grid, y = j / (float)grid;
+                f << "v " << x + o << " " << y << " " << 0.1 * sin(x * 10.0) << "\n"
+                  << "vn 0 0 1\n"
+                  << "vt " << x << " " << y << "\n";
+            }
+        }
+        for (i = 0; i + 1 < grid; ++i) {
+            for (j = 0; j + 1 < grid; ++j) {
+                unsigned int a = base + i * grid + j, b = a + 1;
+                unsigned int c = a + grid, d = c + 1;
+                f << "f " << a << "/" << a << "/" << a << " "
+                  << c << "/" << c << "/" << c << " "
+                  << b << "/" << b << "/" << b << "\n"
+                  << "f " << b << "/" << b << "/" << b << " "
+                  << c << "/" << c << "/" << c << " "
+                  << d << "/" << d << "/" << d << "\n";
+            }
+        }
+        base += grid * grid;
+    }
+}
+
+template <class T>
+void WriteLE(ostream& out, T value) {
+    unsigned char bytes[sizeof(T)];
+    memcpy(bytes, &value, sizeof(T));
+    unsigned short one = 1;
+    if (*(unsigned char*)&one != 1) {
+        for (unsigned int i = 0; i < sizeof(T) / 2; ++i)
+            std::swap(bytes[i], bytes[sizeof(T) - 1 - i]);
+    }
+    out.write((const char*)bytes, sizeof(T));
+}
+
+/**
+ * Binary PLY triangle mesh of a grid, loaded through Assimp.
+ */
+void WritePLYMesh(string file, unsigned int grid) {
+    unsigned int i, j;
+    ofstream f(file.c_str(), std::ios::out | std::ios::binary);
+    f << "ply\n"
+      << "format binary_little_endian 1.0\n"
+      << "element vertex " << grid * grid << "\n"
+      << "property float x\nproperty float y\nproperty float z\n"
+      << "property float nx\nproperty float ny\nproperty float nz\n"
+      << "element face " << (grid - 1) * (grid - 1) * 2 << "\n"
+      << "property list uchar int vertex_indices\n"
+      << "end_header\n";
+    for (i = 0; i < grid; ++i) {
+        for (j = 0; j < grid; ++j) {
+            WriteLE(f, i / (float)grid);
+            WriteLE(f, j / (float)grid);
+            WriteLE(f, 0.1f * (float)sin(i * 0.1));
+            WriteLE(f, 0.0f); WriteLE(f, 0.0f); WriteLE(f, 1.0f);
+        }
+    }
+    for (i = 0; i + 1 < grid; ++i) {
+        for (j = 0; j + 1 < grid; ++j) {
+            int a = i * grid + j, b = a + 1, c = a + grid, d = c + 1;
+            WriteLE(f, (unsigned char)3); WriteLE(f, a); WriteLE(f, c); WriteLE(f, b);
+            WriteLE(f, (unsigned char)3); WriteLE(f, b); WriteLE(f, c); WriteLE(f, d);
+        }
+    }
+}
+
+/**
+ * Binary PLY point cloud with colors, loaded by the streaming loader.
+ */
+void WritePLYPoints(string file, unsigned int points) {
+    ofstream f(file.c_str(), std::ios::out | std::ios::binary);
+    f << "ply\n"
+      << "format binary_little_endian 1.0\n"
+      << "element vertex " << points << "\n"
+      << "property float x\nproperty float y\nproperty float z\n"
+      << "property uchar red\nproperty uchar green\nproperty uchar blue\n"
+      << "end_header\n";
+    srand(42);
+    for (unsigned int i = 0; i < points; ++i) {
+        WriteLE(f, rand() / (float)RAND_MAX * 100.0f);
+        WriteLE(f, rand() / (float)RAND_MAX * 100.0f);
+        WriteLE(f, rand() / (float)RAND_MAX * 10.0f);
+        WriteLE(f, (unsigned char)(i % 256));
+        WriteLE(f, (unsigned char)((i / 256) % 256));
+        WriteLE(f, (unsigned char)128);
+    }
+}
+
+void WriteSource(ostream& f, string id, vector<float>& values,
+                 unsigned int stride, string params) {
+    f << "<source id=\"" << id << "\">"
+      << "<float_array id=\"" << id << "-array\" count=\"" << values.size() << "\">";
+    for (unsigned int i = 0; i < values.size(); ++i)
+        f << values[i] << " ";
+    f << "</float_array><technique_common>"
+      << "<accessor source=\"#" << id << "-array\" count=\"" << values.size() / stride
+      << "\" stride=\"" << stride << "\">" << params << "</accessor>"
+      << "</technique_common></source>\n";
+}
+
+static const char* xyz =
+    "<param name=\"X\" type=\"float\"/>"
+    "<param name=\"Y\" type=\"float\"/>"
+    "<param name=\"Z\" type=\"float\"/>";
+
+/**
+ * Cylinder along the y axis with rings of segments vertices.
+ */
+void Cylinder(unsigned int rings, unsigned int segments, float height,
+              vector<float>& pos, vector<float>& norm, vector<unsigned int>& tris) {
+    unsigned int i, j;
+    for (i = 0; i < rings; ++i) {
+        for (j = 0; j < segments; ++j) {
+            float a = 2.0f * 3.14159265f * j / segments;
+            pos.push_back(cos(a));
+            pos.push_back(height * i / (rings - 1));
+            pos.push_back(sin(a));
+            norm.push_back(cos(a));
+            norm.push_back(0.0f);
+            norm.push_back(sin(a));
+        }
+    }
+    for (i = 0; i + 1 < rings; ++i) {
+        for (j = 0; j < segments; ++j) {
+            unsigned int a = i * segments + j, b = i * segments + (j + 1) % segments;
+            unsigned int c = a + segments, d = b + segments;
+            tris.push_back(a); tris.push_back(c); tris.push_back(b);
+            tris.push_back(b); tris.push_back(c); tris.push_back(d);
+        }
+    }
+}
+
+void WriteDAEHeader(ostream& f, unsigned int materials) {
+    unsigned int i;
+    f << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+      << "<COLLADA xmlns=\"http://www.collada.org/2005/11/COLLADASchema\" version=\"1.4.1\">\n"
+      << "<asset><unit name=\"meter\" meter=\"1\"/><up_axis>Y_UP</up_axis></asset>\n"
+      << "<library_effects>\n";
+    for (i = 0; i < materials; ++i) {
+        f << "<effect id=\"mat" << i << "-fx\"><profile_COMMON><technique sid=\"common\"><phong>"
+          << "<diffuse><color>" << (i % 3) / 2.0 << " " << (i % 5) / 4.0 << " 0.5 1</color></diffuse>"
+          << "<specular><color>0.5 0.5 0.5 1</color></specular>"
+          << "<shininess><float>" << 10 + i << "</float></shininess>"
+          << "</phong></technique></profile_COMMON></effect>\n";
+    }
+    f << "</library_effects>\n<library_materials>\n";
+    for (i = 0; i < materials; ++i)
+        f << "<material id=\"mat" << i << "\" name=\"mat" << i << "\">"
+          << "<instance_effect url=\"#mat" << i << "-fx\"/></material>\n";
+    f << "</library_materials>\n";
+}
+
+void WriteDAEGeometry(ostream& f, string id, vector<float>& pos,
+                      vector<float>& norm, vector<unsigned int>& tris) {
+    f << "<geometry id=\"" << id << "\" name=\"" << id << "\"><mesh>\n";
+    WriteSource(f, id + "-pos", pos, 3, xyz);
+    WriteSource(f, id + "-norm", norm, 3, xyz);
+    f << "<vertices id=\"" << id << "-vtx\">"
+      << "<input semantic=\"POSITION\" source=\"#" << id << "-pos\"/>"
+      << "<input semantic=\"NORMAL\" source=\"#" << id << "-norm\"/></vertices>\n"
+      << "<triangles material=\"mat\" count=\"" << tris.size() / 3 << "\">"
+      << "<input semantic=\"VERTEX\" source=\"#" << id << "-vtx\" offset=\"0\"/><p>";
+    for (unsigned int i = 0; i < tris.size(); ++i)
+        f << tris[i] << " ";
+    f << "</p></triangles>\n</mesh></geometry>\n";
+}
+
+void WriteDAEBindMaterial(ostream& f, unsigned int material) {
+    f << "<bind_material><technique_common>"
+      << "<instance_material symbol=\"mat\" target=\"#mat" << material << "\"/>"
+      << "</technique_common></bind_material>";
+}
+
+void WriteDAEHierarchyNode(ostream& f, unsigned int depth, unsigned int fanout,
+                           unsigned int materials, unsigned int& count) {
+    unsigned int id = count++;
+    f << "<node id=\"node" << id << "\" name=\"node" << id << "\">"
+      << "<matrix sid=\"transform\">1 0 0 " << id % 7 << " 0 1 0 " << depth
+      << " 0 0 1 " << id % 5 << " 0 0 0 1</matrix>"
+      << "<instance_geometry url=\"#geom\">";
+    WriteDAEBindMaterial(f, id % materials);
+    f << "</instance_geometry>\n";
+    if (depth > 0) {
+        for (unsigned int i = 0; i < fanout; ++i)
+            WriteDAEHierarchyNode(f, depth - 1, fanout, materials, count);
+    }
+    f << "</node>\n";
+}
+
+/**
+ * COLLADA scene with a tree of nodes instancing a shared mesh.
+ */
+void WriteDAEHierarchy(string file, unsigned int depth, unsigned int fanout,
+                       unsigned int materials, unsigned int segments) {
+    vector<float> pos, norm;
+    vector<unsigned int> tris;
+    Cylinder(segments, segments, 1.0f, pos, norm, tris);
+
+    ofstream f(file.c_str());
+    WriteDAEHeader(f, materials);
+    f << "<library_geometries>\n";
+    WriteDAEGeometry(f, "geom", pos, norm, tris);
+    f << "</library_geometries>\n"
+      << "<library_visual_scenes><visual_scene id=\"scene\">\n";
+    unsigned int count = 0;
+    WriteDAEHierarchyNode(f, depth, fanout, materials, count);
+    f << "</visual_scene></library_visual_scenes>\n"
+      << "<scene><instance_visual_scene url=\"#scene\"/></scene>\n"
+      << "</COLLADA>\n";
+}
+
+/**
+ * COLLADA scene with a cylinder skinned to a chain of joints, each
+ * joint animated with a number of matrix keys.
+ */
+void WriteDAESkinned(string file, unsigned int joints, unsigned int rings,
+                     unsigned int segments, unsigned int keys) {
+    unsigned int i, k;
+    float length = 1.0f;
+    vector<float> pos, norm;
+    vector<unsigned int> tris;
+    Cylinder(rings, segments, joints * length, pos, norm, tris);
+    unsigned int verts = pos.size() / 3;
+
+    ofstream f(file.c_str());
+    WriteDAEHeader(f, 1);
+    f << "<library_geometries>\n";
+    WriteDAEGeometry(f, "geom", pos, norm, tris);
+    f << "</library_geometries>\n";
+
+    // skin: each vertex is weighted between the two closest joints.
+    f << "<library_controllers><controller id=\"skin\"><skin source=\"#geom\">"
+      << "<bind_shape_matrix>1 0 0 0 0 1 0 0 0 0 1 0 0 0 0 1</bind_shape_matrix>\n"
+      << "<source id=\"skin-joints\"><Name_array id=\"skin-joints-array\" count=\"" << joints << "\">";
+    for (i = 0; i < joints; ++i)
+        f << "joint" << i << " ";
+    f << "</Name_array><technique_common><accessor source=\"#skin-joints-array\" count=\""
+      << joints << "\" stride=\"1\"><param name=\"JOINT\" type=\"name\"/></accessor>"
+      << "</technique_common></source>\n";
+    vector<float> binds, weights;
+    for (i = 0; i < joints; ++i) {
+        float m[16] = { 1, 0, 0, 0,  0, 1, 0, -(float)i * length,  0, 0, 1, 0,  0, 0, 0, 1 };
+        binds.insert(binds.end(), m, m + 16);
+    }
+    WriteSource(f, "skin-binds", binds, 16, "<param name=\"TRANSFORM\" type=\"float4x4\"/>");
+    ostringstream vcount, v;
+    for (i = 0; i < verts; ++i) {
+        float y = pos[i * 3 + 1] / length;
+        unsigned int joint = (unsigned int)y;
+        if (joint >= joints - 1) joint = joints > 1 ? joints - 2 : 0;
+        float w = y - joint;
+        if (w > 1.0f) w = 1.0f;
+        if (joints > 1) {
+            vcount << "2 ";
+            v << joint << " " << weights.size() << " ";
+            weights.push_back(1.0f - w);
+            v << joint + 1 << " " << weights.size() << " ";
+            weights.push_back(w);
+        }
+        else {
+            vcount << "1 ";
+            v << 0 << " " << weights.size() << " ";
+            weights.push_back(1.0f);
+        }
+    }
+    WriteSource(f, "skin-weights", weights, 1, "<param name=\"WEIGHT\" type=\"float\"/>");
+    f << "<joints><input semantic=\"JOINT\" source=\"#skin-joints\"/>"
+      << "<input semantic=\"INV_BIND_MATRIX\" source=\"#skin-binds\"/></joints>\n"
+      << "<vertex_weights count=\"" << verts << "\">"
+      << "<input semantic=\"JOINT\" source=\"#skin-joints\" offset=\"0\"/>"
+      << "<input semantic=\"WEIGHT\" source=\"#skin-weights\" offset=\"1\"/>"
+      << "<vcount>" << vcount.str() << "</vcount><v>" << v.str() << "</v>"
+      << "</vertex_weights></skin></controller></library_controllers>\n";
+
+    // every joint but the root bends around z over time.
+    f << "<library_animations>\n";
+    for (i = 0; i < joints; ++i) {
+        ostringstream name;
+        name << "joint" << i;
+        string id = name.str();
+        vector<float> times, matrices;
+        for (k = 0; k < keys; ++k) {
+            float t = k / 30.0f, a = 0.3f * sinf(t * 2.0f + i);
+            float m[16] = { cosf(a), -sinf(a), 0, 0,
+                            sinf(a),  cosf(a), 0, i > 0 ? length : 0,
+                            0, 0, 1, 0,
+                            0, 0, 0, 1 };
+            times.push_back(t);
+            matrices.insert(matrices.end(), m, m + 16);
+        }
+        f << "<animation id=\"" << id << "-anim\">\n";
+        WriteSource(f, id + "-in", times, 1, "<param name=\"TIME\" type=\"float\"/>");
+        WriteSource(f, id + "-out", matrices, 16, "<param name=\"TRANSFORM\" type=\"float4x4\"/>");
+        f << "<source id=\"" << id << "-interp\"><Name_array id=\"" << id
+          << "-interp-array\" count=\"" << keys << "\">";
+        for (k = 0; k < keys; ++k)
+            f << "LINEAR ";
+        f << "</Name_array><technique_common><accessor source=\"#" << id
+          << "-interp-array\" count=\"" << keys << "\" stride=\"1\">"
+          << "<param name=\"INTERPOLATION\" type=\"name\"/></accessor></technique_common></source>\n"
+          << "<sampler id=\"" << id << "-sampler\">"
+          << "<input semantic=\"INPUT\" source=\"#" << id << "-in\"/>"
+          << "<input semantic=\"OUTPUT\" source=\"#" << id << "-out\"/>"
+          << "<input semantic=\"INTERPOLATION\" source=\"#" << id << "-interp\"/></sampler>\n"
+          << "<channel source=\"#" << id << "-sampler\" target=\"" << id << "/transform\"/>\n"
+          << "</animation>\n";
+    }
+    f << "</library_animations>\n"
+      << "<library_visual_scenes><visual_scene id=\"scene\">\n";
+    for (i = 0; i < joints; ++i) {
+        f << "<node id=\"joint" << i << "\" sid=\"joint" << i << "\" name=\"joint" << i
+          << "\" type=\"JOINT\"><matrix sid=\"transform\">1 0 0 0 0 1 0 "
+          << (i > 0 ? length : 0) << " 0 0 1 0 0 0 0 1</matrix>\n";
+    }
+    for (i = 0; i < joints; ++i)
+        f << "</node>\n";
+    f << "<node id=\"skinned\" name=\"skinned\"><instance_controller url=\"#skin\">"
+      << "<skeleton>#joint0</skeleton>";
+    WriteDAEBindMaterial(f, 0);
+    f << "</instance_controller></node>\n"
+      << "</visual_scene></library_visual_scenes>\n"
+      << "<scene><instance_visual_scene url=\"#scene\"/></scene>\n"
+      << "</COLLADA>\n";
+}
+
+// ---------------------------------------------------------------
+// Benchmark driver
+// ---------------------------------------------------------------
+
+struct Result {
+    string name, format, file, error;
+    unsigned int runs;
+    // best of the runs, in microseconds.
+    AssimpLoadStatistics best;
+    unsigned long bestTotal, sumTotal;
+    unsigned long allocations, allocated, peakHeap;
+    unsigned long points, proxies;
+    bool stats, collision;
+};
+
+/**
+ * Load a model a number of times, keeping the fastest time of each
+ * phase and the heap usage of the first load. Collision proxies are
+ * built if enabled in the options, streamed models have none.
+ */
+Result Run(string name, string format, string file, unsigned int runs, bool stream,
+           CollisionOptions collision = CollisionOptions()) {
+    Result r;
+    r.name = name;
+    r.format = format;
+    r.file = file;
+    r.runs = runs;
+    r.bestTotal = r.sumTotal = 0;
+    r.allocations = r.allocated = r.peakHeap = 0;
+    r.points = r.proxies = 0;
+    r.stats = !stream;
+    r.collision = !stream && collision.enabled;
+
+    AssimpPlugin plugin;
+    if (stream) plugin.SetStreamThreshold(0);
+
+    for (unsigned int i = 0; i < runs; ++i) {
+        counterLock->Lock();
+        unsigned long count = allocCount, bytes = allocBytes, live = liveBytes;
+        peakBytes = liveBytes;
+        counterLock->Unlock();
+        Timer timer;
+        timer.Start();
+        try {
+            AssimpResource* assimp = stream ? NULL : new AssimpResource(file);
+            IModelResourcePtr res = stream
+                ? plugin.CreateResource(file)
+                : IModelResourcePtr(assimp);
+            if (assimp) assimp->SetCollisionOptions(collision);
+            res->Load();
+            unsigned long total = timer.GetElapsedIntervals(1);
+            AssimpPLYStreamResource* points = 
+                dynamic_cast<AssimpPLYStreamResource*>(res.get());
+            if (points) r.points = points->GetNumPoints();
+            if (assimp) {
+                r.proxies = assimp->GetCollisionProxies().size();
+                AssimpLoadStatistics s = assimp->GetLoadStatistics();
+                if (i == 0) r.best = s;
+#define BEST(field) if (s.field < r.best.field) r.best.field = s.field
+                BEST(importTime); BEST(hashTime); BEST(materialTime); BEST(meshTime);
+                BEST(sceneTime); BEST(animationTime); BEST(animatedMeshTime);
+                BEST(collisionTime);
+#undef BEST
+            }
+            if (i == 0 || total < r.bestTotal) r.bestTotal = total;
+            r.sumTotal += total;
+            if (i == 0) {
+                counterLock->Lock();
+                r.allocations = allocCount - count;
+                r.allocated = allocBytes - bytes;
+                r.peakHeap = peakBytes - live;
+                counterLock->Unlock();
+            }
+            res->Unload();
+        } catch (ResourceException* e) {
+            r.error = e->what();
+            delete e;
+            break;
+        } catch (std::exception& e) {
+            r.error = e.what();
+            break;
+        }
+    }
+    return r;
+}
+
+string Escape(string s) {
+    string out;
+    for (unsigned int i = 0; i < s.size(); ++i) {
+        if (s[i] == '"' || s[i] == '\\') out += '\\';
+        if ((unsigned char)s[i] < 0x20) out += ' ';
+        else out += s[i];
+    }
+    return out;
+}
+
+double PerSecond(unsigned long count, unsigned long usec) {
+    return usec > 0 ? count * 1e6 / usec : 0.0;
+}
+
+void WriteJSON(ostream& out, vector<Result>& results, unsigned int runs, double scale) {
+    out << "{\n  \"benchmark\": \"AssimpResource::Load\",\n"
+        << "  \"runs\": " << runs << ",\n"
+        << "  \"scale\": " << scale << ",\n"
+        << "  \"cases\": [\n";
+    for (unsigned int i = 0; i < results.size(); ++i) {
+        Result& r = results[i];
+        AssimpLoadStatistics& s = r.best;
+        out << "    {\"name\": \"" << r.name << "\", \"format\": \"" << r.format << "\""
+            << ", \"file\": \"" << Escape(r.file) << "\"";
+        if (!r.error.empty())
+            out << ", \"error\": \"" << Escape(r.error) << "\"";
+        out << ",\n     \"total_us\": {\"min\": " << r.bestTotal
+            << ", \"mean\": " << (r.runs ? r.sumTotal / r.runs : 0) << "}";
+        if (r.stats) {
+            out << ",\n     \"phases_us\": {\"import\": " << s.importTime
+                << ", \"hash\": " << s.hashTime
+                << ", \"materials\": " << s.materialTime
+                << ", \"meshes\": " << s.meshTime
+                << ", \"scene\": " << s.sceneTime
+                << ", \"animations\": " << s.animationTime
+                << ", \"animated_meshes\": " << s.animatedMeshTime
+                << ", \"collision\": " << s.collisionTime << "}"
+                << ",\n     \"meshes\": " << s.numMeshes
+                << ", \"vertices\": " << s.numVertices
+                << ", \"faces\": " << s.numFaces
+                << ", \"materials\": " << s.numMaterials
+                << ", \"nodes\": " << s.numNodes
+                << ", \"keys\": " << s.numKeys
+                << ",\n     \"vertices_per_s\": " << PerSecond(s.numVertices, r.bestTotal)
+                << ", \"keys_per_s\": " << PerSecond(s.numKeys, r.bestTotal);
+        }
+        else {
+            out << ",\n     \"points\": " << r.points
+                << ", \"vertices_per_s\": " << PerSecond(r.points, r.bestTotal);
+        }
+        if (r.collision)
+            out << ",\n     \"collision_proxies\": " << r.proxies;
+        out << ",\n     \"allocations\": " << r.allocations
+            << ", \"allocated_bytes\": " << r.allocated
+            << ", \"peak_heap_bytes\": " << r.peakHeap << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    // the resident set only grows, so it is reported for the whole run.
+    out << "  ],\n  \"peak_rss_kb\": " << PeakRSS() << "\n}\n";
+}
+
+int main(int argc, char** argv) {
+    unsigned int runs = 3;
+    double scale = 1.0;
+    string dir = ".", output;
+    bool keep = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if      (arg == "-r" && i + 1 < argc) runs = atoi(argv[++i]);
+        else if (arg == "-s" && i + 1 < argc) scale = atof(argv[++i]);
+        else if (arg == "-d" && i + 1 < argc) dir = argv[++i];
+        else if (arg == "-o" && i + 1 < argc) output = argv[++i];
+        else if (arg == "-k") keep = true;
+        else {
+            std::cerr << "usage: " << argv[0]
+                      << " [-r runs] [-s scale] [-d dir] [-o file] [-k]" << std::endl;
+            return 1;
+        }
+    }
+    if (runs == 0) runs = 1;
+    if (scale <= 0.0) scale = 1.0;
+    double side = sqrt(scale);
+    dir += "/";
+    counterLock = new Mutex();
+
+    // proxies are rebuilt on each load to time them.
+    CollisionOptions dynamic;
+    dynamic.enabled = true;
+    dynamic.cache = false;
+    CollisionOptions fixed = dynamic;
+    fixed.granularity = CollisionOptions::PER_NODE;
+    fixed.mode = CollisionOptions::STATIC;
+
+    vector<string> files;
+    vector<Result> results;
+
+    string obj = dir + "assimp-bench-grid.obj", mtl = dir + "assimp-bench-grid.mtl";
+    WriteOBJ(obj, mtl, 8, (unsigned int)(128 * side), 4);
+    files.push_back(obj); files.push_back(mtl);
+    results.push_back(Run("obj-grid", "obj", obj, runs, false));
+    results.push_back(Run("obj-grid-collision", "obj", obj, runs, false, dynamic));
+
+    obj = dir + "assimp-bench-materials.obj", mtl = dir + "assimp-bench-materials.mtl";
+    WriteOBJ(obj, mtl, (unsigned int)(256 * scale), 8, 64);
+    files.push_back(obj); files.push_back(mtl);
+    results.push_back(Run("obj-materials", "obj", obj, runs, false));
+
+    string ply = dir + "assimp-bench-mesh.ply";
+    WritePLYMesh(ply, (unsigned int)(512 * side));
+    files.push_back(ply);
+    results.push_back(Run("ply-mesh", "ply", ply, runs, false));
+
+    ply = dir + "assimp-bench-points.ply";
+    WritePLYPoints(ply, (unsigned int)(1000000 * scale));
+    files.push_back(ply);
+    results.push_back(Run("ply-points-stream", "ply", ply, runs, true));
+
+    string dae = dir + "assimp-bench-hierarchy.dae";
+    WriteDAEHierarchy(dae, 4, 4, 16, (unsigned int)(16 * side));
+    files.push_back(dae);
+    results.push_back(Run("dae-hierarchy", "dae", dae, runs, false));
+    results.push_back(Run("dae-hierarchy-collision", "dae", dae, runs, false, fixed));
+
+    dae = dir + "assimp-bench-skinned.dae";
+    WriteDAESkinned(dae, 32, (unsigned int)(256 * side), 64, (unsigned int)(240 * scale));
+    files.push_back(dae);
+    results.push_back(Run("dae-skinned", "dae", dae, runs, false));
+
+    if (!keep) {
+        for (unsigned int i = 0; i < files.size(); ++i)
+            remove(files[i].c_str());
+    }
+
+    if (output.empty())
+        WriteJSON(std::cout, results, runs, scale);
+    else {
+        ofstream out(output.c_str());
+        WriteJSON(out, results, runs, scale);
+    }
+
+    for (unsigned int i = 0; i < results.size(); ++i)
+        if (!results[i].error.empty()) return 1;
+    return 0;
+}
@@ -0,0 +1,903 @@
+// Collision proxies generated at import time.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Resources/AssimpCollisionProxy.h>
+
+#include <Core/Thread.h>
+#include <Logging/Logger.h>
+
+#include <fstream>
+#include <map>
+#include <set>
+#include <queue>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <exception>
+
+namespace OpenEngine {
+namespace Resources {
+
+using std::map;
+using std::set;
+using std::pair;
+using std::make_pair;
+
+struct P3 {
+    float x, y, z;
+    P3(): x(0), y(0), z(0) {}
+    P3(float x, float y, float z): x(x), y(y), z(z) {}
+};
+
+inline P3 operator+(P3 a, P3 b) { return P3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline P3 operator-(P3 a, P3 b) { return P3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline P3 operator*(P3 a, float s) { return P3(a.x * s, a.y * s, a.z * s); }
+inline float Dot(P3 a, P3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline P3 Cross(P3 a, P3 b) {
+    return P3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+inline float Length(P3 a) { return sqrt(Dot(a, a)); }
+inline float Get(P3 a, int axis) { return axis == 0 ? a.x : (axis == 1 ? a.y : a.z); }
+
+typedef pair<int, pair<int, int> > Cell;
+
+inline Cell CellOf(P3 p, P3 min, float size) {
+    return make_pair((int)floor((p.x - min.x) / size),
+                     make_pair((int)floor((p.y - min.y) / size),
+                               (int)floor((p.z - min.z) / size)));
+}
+
+inline void Bounds(vector<P3>& points, P3& min, P3& max) {
+    min = P3( FLT_MAX,  FLT_MAX,  FLT_MAX);
+    max = P3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (unsigned int i = 0; i < points.size(); ++i) {
+        P3 p = points[i];
+        min = P3(p.x < min.x ? p.x : min.x, p.y < min.y ? p.y : min.y, p.z < min.z ? p.z : min.z);
+        max = P3(p.x > max.x ? p.x : max.x, p.y > max.y ? p.y : max.y, p.z > max.z ? p.z : max.z);
+    }
+}
+
+/**
+ * Collect the triangles of the meshes into one indexed triangle list.
+ */
+inline void Gather(vector<aiMesh*>& meshes, vector<P3>& points, vector<unsigned int>& tris) {
+    for (unsigned int i = 0; i < meshes.size(); ++i) {
+        aiMesh* m = meshes[i];
+        unsigned int j, offset = points.size();
+        for (j = 0; j < m->mNumVertices; ++j)
+            points.push_back(P3(m->mVertices[j].x, m->mVertices[j].y, m->mVertices[j].z));
+        for (j = 0; j < m->mNumFaces; ++j) {
+            aiFace& f = m->mFaces[j];
+            if (f.mNumIndices != 3) continue;
+            tris.push_back(offset + f.mIndices[0]);
+            tris.push_back(offset + f.mIndices[1]);
+            tris.push_back(offset + f.mIndices[2]);
+        }
+    }
+}
+
+/**
+ * Keep the first point of each grid cell. The points kept are
+ * original vertices so hulls of them stay inside the mesh hull.
+ */
+inline void Reduce(vector<P3>& points, float size, vector<P3>& out) {
+    P3 min, max;
+    Bounds(points, min, max);
+    set<Cell> cells;
+    for (unsigned int i = 0; i < points.size(); ++i) {
+        if (size > 0.0f && !cells.insert(CellOf(points[i], min, size)).second) continue;
+        out.push_back(points[i]);
+    }
+}
+
+struct HullFace {
+    unsigned int v[3];
+    P3 n;
+    float d;
+    bool alive;
+    // points outside the face not yet on the hull, and the farthest one.
+    vector<unsigned int> outside;
+    unsigned int far;
+    float farDist;
+};
+
+/**
+ * Face through three points. The normal is left zero if the face is
+ * thinner than eps.
+ */
+inline HullFace MakeFace(vector<P3>& p, unsigned int a, unsigned int b, unsigned int c,
+                         float eps = 0.0f) {
+    HullFace f;
+    f.v[0] = a; f.v[1] = b; f.v[2] = c;
+    f.n = Cross(p[b] - p[a], p[c] - p[a]);
+    float l = Length(f.n);
+    float edge = std::max(Length(p[b] - p[a]), std::max(Length(p[c] - p[b]), Length(p[a] - p[c])));
+    if (l > eps * edge && l > 0.0f) f.n = f.n * (1.0f / l);
+    else f.n = P3();
+    f.d = Dot(f.n, p[a]);
+    f.alive = true;
+    f.far = 0;
+    f.farDist = 0.0f;
+    return f;
+}
+
+inline bool Degenerate(HullFace& f) {
+    return f.n.x == 0.0f && f.n.y == 0.0f && f.n.z == 0.0f;
+}
+
+/**
+ * Put a point on the outside list of the face among the candidates it
+ * is farthest in front of, if it is more than eps in front of any.
+ */
+inline void Assign(vector<P3>& p, unsigned int i, vector<HullFace>& faces,
+                   vector<unsigned int>& candidates, float eps) {
+    unsigned int best = 0;
+    float bestDist = eps;
+    for (unsigned int j = 0; j < candidates.size(); ++j) {
+        HullFace& f = faces[candidates[j]];
+        float dist = Dot(f.n, p[i]) - f.d;
+        if (dist > bestDist) { bestDist = dist; best = candidates[j]; }
+    }
+    if (bestDist == eps) return;
+    HullFace& f = faces[best];
+    f.outside.push_back(i);
+    if (bestDist > f.farDist) { f.farDist = bestDist; f.far = i; }
+}
+
+/**
+ * Hull of a flat point set, left as the corners of the outline in the
+ * plane of the points with no indices.
+ */
+inline void FlatHull(vector<P3>& p, P3 origin, P3 u, P3 w, float eps,
+                     unsigned int maxVertices, CollisionShape& out) {
+    // monotone chain on the plane coordinates.
+    vector<pair<pair<float, float>, unsigned int> > q;
+    unsigned int i;
+    for (i = 0; i < p.size(); ++i)
+        q.push_back(make_pair(make_pair(Dot(p[i] - origin, u), Dot(p[i] - origin, w)), i));
+    std::sort(q.begin(), q.end());
+    vector<unsigned int> chain(2 * q.size() + 1);
+    unsigned int k = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        unsigned int start = k;
+        for (i = 0; i < q.size(); ++i) {
+            unsigned int c = pass == 0 ? i : q.size() - 1 - i;
+            while (k >= start + 2) {
+                pair<float, float> a = q[chain[k-2]].first, b = q[chain[k-1]].first;
+                float cross = (b.first - a.first) * (q[c].first.second - a.second)
+                    - (b.second - a.second) * (q[c].first.first - a.first);
+                // drop b if it is within eps of the line from a to c.
+                float len = sqrt((q[c].first.first - a.first) * (q[c].first.first - a.first) +
+                                 (q[c].first.second - a.second) * (q[c].first.second - a.second));
+                if (cross > eps * len) break;
+                --k;
+            }
+            chain[k++] = c;
+        }
+        --k; // the last point starts the other half.
+    }
+    if (k == 0) k = 1;
+    unsigned int step = maxVertices > 0 && k > maxVertices ? (k + maxVertices - 1) / maxVertices : 1;
+    for (i = 0; i < k; i += step) {
+        P3 v = p[q[chain[i]].second];
+        out.vertices.push_back(v.x);
+        out.vertices.push_back(v.y);
+        out.vertices.push_back(v.z);
+    }
+}
+
+/**
+ * Quickhull. Points are added farthest first, and points closer than
+ * eps to the hull or beyond maxVertices (zero for no limit) are left
+ * out, so the hull approximates the points within eps. Points that
+ * would make degenerate faces are skipped.
+ */
+inline void QuickHull(vector<P3>& p, float eps, unsigned int maxVertices,
+                      vector<HullFace>& faces, P3& u, P3& w, unsigned int& origin) {
+    unsigned int i, j, k, n = p.size();
+    faces.clear();
+
+    // initial tetrahedron from the extreme points.
+    unsigned int i0 = 0, i1 = 0, i2 = 0, i3 = 0;
+    for (i = 0; i < n; ++i) {
+        if (p[i].x < p[i0].x) i0 = i;
+    }
+    float best = 0.0f;
+    for (i = 0; i < n; ++i) {
+        float dist = Length(p[i] - p[i0]);
+        if (dist > best) { best = dist; i1 = i; }
+    }
+    origin = i0;
+    u = w = P3();
+    if (best <= eps) return;
+    P3 axis = (p[i1] - p[i0]) * (1.0f / best);
+    best = 0.0f;
+    for (i = 0; i < n; ++i) {
+        float dist = Length(Cross(axis, p[i] - p[i0]));
+        if (dist > best) { best = dist; i2 = i; }
+    }
+    u = axis;
+    if (best <= eps) return;
+    HullFace base = MakeFace(p, i0, i1, i2);
+    w = Cross(base.n, u);
+    best = 0.0f;
+    for (i = 0; i < n; ++i) {
+        float dist = fabs(Dot(base.n, p[i]) - base.d);
+        if (dist > best) { best = dist; i3 = i; }
+    }
+    if (best <= eps) return;
+
+    P3 center = (p[i0] + p[i1] + p[i2] + p[i3]) * 0.25f;
+    unsigned int tet[4][3] = { {i0, i1, i2}, {i0, i3, i1}, {i1, i3, i2}, {i2, i3, i0} };
+    // faces by directed edge, the neighbour across (a, b) owns (b, a).
+    map<pair<unsigned int, unsigned int>, unsigned int> edges;
+    for (i = 0; i < 4; ++i) {
+        HullFace f = MakeFace(p, tet[i][0], tet[i][1], tet[i][2]);
+        if (Dot(f.n, center) - f.d > 0.0f)
+            f = MakeFace(p, tet[i][0], tet[i][2], tet[i][1]);
+        for (k = 0; k < 3; ++k)
+            edges[make_pair(f.v[k], f.v[(k+1) % 3])] = faces.size();
+        faces.push_back(f);
+    }
+    vector<unsigned int> candidates;
+    for (j = 0; j < 4; ++j) candidates.push_back(j);
+    for (i = 0; i < n; ++i) {
+        if (i == i0 || i == i1 || i == i2 || i == i3) continue;
+        Assign(p, i, faces, candidates, eps);
+    }
+
+    // faces by the distance of their farthest outside point. Entries
+    // of dead faces or old distances are skipped.
+    std::priority_queue<pair<float, unsigned int> > queue;
+    for (j = 0; j < faces.size(); ++j)
+        if (!faces[j].outside.empty()) queue.push(make_pair(faces[j].farDist, j));
+
+    unsigned int vertices = 4;
+    while (maxVertices == 0 || vertices < maxVertices) {
+        // the point farthest outside the hull.
+        if (queue.empty()) break;
+        unsigned int top = queue.top().second;
+        float dist = queue.top().first;
+        queue.pop();
+        if (!faces[top].alive || faces[top].outside.empty() || 
+            faces[top].farDist != dist) continue;
+        unsigned int eye = faces[top].far;
+
+        // faces connected to the top face the point is above, and their
+        // horizon. Faces across the horizon that the new faces would be
+        // degenerate with, or fold over, are taken as visible too until
+        // the new faces are convex.
+        vector<unsigned int> visible, horizon, across;
+        vector<HullFace> cone;
+        map<unsigned int, unsigned int> loop;
+        set<unsigned int> seen, forced;
+        bool convex = false;
+        for (unsigned int attempt = 0; attempt < 8 && !convex; ++attempt) {
+            visible.assign(1, top);
+            seen.clear();
+            seen.insert(top);
+            horizon.clear();
+            across.clear();
+            for (j = 0; j < visible.size(); ++j) {
+                HullFace& f = faces[visible[j]];
+                for (k = 0; k < 3; ++k) {
+                    unsigned int a = f.v[k], b = f.v[(k+1) % 3];
+                    unsigned int g = edges[make_pair(b, a)];
+                    if (seen.count(g)) continue;
+                    if (forced.count(g) || Dot(faces[g].n, p[eye]) - faces[g].d > 0.0f) {
+                        seen.insert(g);
+                        visible.push_back(g);
+                    }
+                    else {
+                        horizon.push_back(a);
+                        horizon.push_back(b);
+                        across.push_back(g);
+                    }
+                }
+            }
+            // the horizon must be a single loop.
+            cone.clear();
+            loop.clear();
+            for (j = 0; j < across.size(); ++j) {
+                cone.push_back(MakeFace(p, horizon[2*j], horizon[2*j+1], eye, eps));
+                loop[horizon[2*j]] = j;
+            }
+            unsigned int steps = 0, v = horizon[0];
+            while (steps <= cone.size() && loop.count(v)) {
+                v = horizon[2 * loop[v] + 1];
+                ++steps;
+                if (v == horizon[0]) break;
+            }
+            if (v != horizon[0] || steps != cone.size()) break;
+
+            // only faces the point is coplanar with can be taken as
+            // visible without cutting off a part of the hull.
+            convex = true;
+            bool stuck = false;
+            for (j = 0; j < cone.size(); ++j) {
+                HullFace& f = cone[j];
+                HullFace& g = faces[across[j]];
+                unsigned int opposite = g.v[0] + g.v[1] + g.v[2] - f.v[0] - f.v[1];
+                unsigned int next = loop[f.v[1]];
+                float tiny = eps * 0.01f;
+                vector<unsigned int> fold;
+                if (Degenerate(f) || Dot(f.n, p[opposite]) - f.d > tiny)
+                    fold.push_back(across[j]);
+                else if (Dot(f.n, p[cone[next].v[1]]) - f.d > tiny) {
+                    fold.push_back(across[j]);
+                    fold.push_back(across[next]);
+                }
+                for (k = 0; k < fold.size(); ++k) {
+                    stuck = stuck || Dot(faces[fold[k]].n, p[eye]) - faces[fold[k]].d < -eps;
+                    forced.insert(fold[k]);
+                    convex = false;
+                }
+            }
+            if (stuck) break;
+        }
+        if (!convex) {
+            // drop the point, it can not be added robustly.
+            vector<unsigned int>& out = faces[top].outside;
+            out.erase(std::find(out.begin(), out.end(), eye));
+            faces[top].farDist = 0.0f;
+            for (j = 0; j < out.size(); ++j) {
+                float dist = Dot(faces[top].n, p[out[j]]) - faces[top].d;
+                if (dist > faces[top].farDist) { faces[top].farDist = dist; faces[top].far = out[j]; }
+            }
+            if (!out.empty()) queue.push(make_pair(faces[top].farDist, top));
+            continue;
+        }
+
+        vector<unsigned int> orphans;
+        for (j = 0; j < visible.size(); ++j) {
+            HullFace& f = faces[visible[j]];
+            f.alive = false;
+            for (k = 0; k < 3; ++k)
+                edges.erase(make_pair(f.v[k], f.v[(k+1) % 3]));
+            for (k = 0; k < f.outside.size(); ++k)
+                if (f.outside[k] != eye) orphans.push_back(f.outside[k]);
+            vector<unsigned int>().swap(f.outside);
+        }
+        unsigned int first = faces.size();
+        for (j = 0; j < cone.size(); ++j) {
+            for (k = 0; k < 3; ++k)
+                edges[make_pair(cone[j].v[k], cone[j].v[(k+1) % 3])] = faces.size();
+            faces.push_back(cone[j]);
+        }
+        // orphans outside the new hull are outside a new face or a
+        // face across the horizon.
+        candidates = across;
+        for (j = first; j < faces.size(); ++j) candidates.push_back(j);
+        for (j = 0; j < orphans.size(); ++j)
+            Assign(p, orphans[j], faces, candidates, eps);
+        for (j = first; j < faces.size(); ++j)
+            if (!faces[j].outside.empty()) queue.push(make_pair(faces[j].farDist, j));
+        for (j = 0; j < across.size(); ++j)
+            if (!faces[across[j]].outside.empty()) 
+                queue.push(make_pair(faces[across[j]].farDist, across[j]));
+        ++vertices;
+    }
+}
+
+/**
+ * True if a hull vertex is within eps of the hull of its neighbours,
+ * given the sum of the normals of the faces around it.
+ */
+inline bool Flat(vector<P3>& p, unsigned int v, P3 n, set<unsigned int>& ring, float eps) {
+    float l = Length(n);
+    if (l == 0.0f) return false;
+    vector<P3> neighbours;
+    bool plane = true;
+    set<unsigned int>::iterator r;
+    for (r = ring.begin(); r != ring.end(); ++r) {
+        neighbours.push_back(p[*r]);
+        plane = plane && fabs(Dot(n, p[*r] - p[v])) <= eps * l;
+    }
+    // in a flat region, or on a straight edge or corner.
+    if (plane) return true;
+    vector<HullFace> faces;
+    P3 u, w;
+    unsigned int origin;
+    QuickHull(neighbours, eps, 0, faces, u, w, origin);
+    if (faces.empty()) return false;
+    for (unsigned int i = 0; i < faces.size(); ++i) {
+        if (faces[i].alive && Dot(faces[i].n, p[v]) - faces[i].d > eps) return false;
+    }
+    return true;
+}
+
+/**
+ * Convex hull of a point set with at most maxVertices vertices (zero
+ * for no limit), approximating the points within eps. Hull vertices
+ * whose faces are coplanar within eps are merged away. A degenerate
+ * hull is left as the outline of the points, with no indices.
+ */
+inline void Hull(vector<P3>& p, float eps, unsigned int maxVertices, CollisionShape& out) {
+    unsigned int i, j;
+    if (p.empty()) return;
+    // hull the points around their center to keep the rounding errors
+    // relative to the size of the hull.
+    P3 min, max;
+    Bounds(p, min, max);
+    P3 center = (min + max) * 0.5f;
+    eps = std::max(eps, Length(max - min) * 1e-5f);
+    vector<P3> points;
+    for (i = 0; i < p.size(); ++i)
+        points.push_back(p[i] - center);
+
+    vector<HullFace> faces;
+    P3 u, w;
+    unsigned int origin;
+    QuickHull(points, eps, maxVertices, faces, u, w, origin);
+
+    if (!faces.empty()) {
+        // merge the faces around vertices within eps of the hull of
+        // their neighbours. Neighbours of a merged vertex are kept so
+        // the errors do not add up.
+        map<unsigned int, pair<P3, set<unsigned int> > > rings;
+        for (i = 0; i < faces.size(); ++i) {
+            if (!faces[i].alive) continue;
+            for (j = 0; j < 3; ++j) {
+                pair<P3, set<unsigned int> >& r = rings[faces[i].v[j]];
+                r.first = r.first + faces[i].n;
+                r.second.insert(faces[i].v[(j+1) % 3]);
+            }
+        }
+        vector<P3> kept;
+        set<unsigned int> fixed;
+        map<unsigned int, pair<P3, set<unsigned int> > >::iterator itr;
+        for (itr = rings.begin(); itr != rings.end(); ++itr) {
+            if (fixed.count(itr->first) || 
+                !Flat(points, itr->first, itr->second.first, itr->second.second, eps))
+                kept.push_back(points[itr->first]);
+            else
+                fixed.insert(itr->second.second.begin(), itr->second.second.end());
+        }
+        if (kept.size() < rings.size() && kept.size() >= 4) {
+            points.swap(kept);
+            QuickHull(points, eps, maxVertices, faces, u, w, origin);
+        }
+    }
+
+    if (faces.empty()) {
+        if (Length(w) > 0.0f) {
+            FlatHull(points, points[origin], u, w, eps, maxVertices, out);
+        }
+        else {
+            // a line or a single point, keep the end points.
+            P3 a = points[origin], b = a;
+            for (i = 0; i < points.size(); ++i) {
+                if (Dot(points[i] - a, u) < 0.0f) a = points[i];
+                if (Dot(points[i] - b, u) > 0.0f) b = points[i];
+            }
+            out.vertices.push_back(a.x);
+            out.vertices.push_back(a.y);
+            out.vertices.push_back(a.z);
+            if (Length(u) > 0.0f) {
+                out.vertices.push_back(b.x);
+                out.vertices.push_back(b.y);
+                out.vertices.push_back(b.z);
+            }
+        }
+    }
+    else {
+        map<unsigned int, unsigned int> remap;
+        for (i = 0; i < faces.size(); ++i) {
+            if (!faces[i].alive) continue;
+            for (j = 0; j < 3; ++j) {
+                unsigned int v = faces[i].v[j];
+                map<unsigned int, unsigned int>::iterator itr = remap.find(v);
+                if (itr == remap.end()) {
+                    itr = remap.insert(make_pair(v, (unsigned int)out.vertices.size() / 3)).first;
+                    out.vertices.push_back(points[v].x);
+                    out.vertices.push_back(points[v].y);
+                    out.vertices.push_back(points[v].z);
+                }
+                out.indices.push_back(itr->second);
+            }
+        }
+    }
+    for (i = 0; i < out.vertices.size(); i += 3) {
+        out.vertices[i]   += center.x;
+        out.vertices[i+1] += center.y;
+        out.vertices[i+2] += center.z;
+    }
+}
+
+/**
+ * Depth of the deepest point inside the hull. Zero if all points lie
+ * on the hull, i.e. the points are in convex position.
+ */
+inline float Concavity(vector<P3>& points, CollisionShape& hull) {
+    if (hull.indices.empty()) return 0.0f;
+    vector<P3> hp;
+    unsigned int i, j;
+    for (i = 0; i < hull.vertices.size(); i += 3)
+        hp.push_back(P3(hull.vertices[i], hull.vertices[i+1], hull.vertices[i+2]));
+    vector<HullFace> planes;
+    for (i = 0; i < hull.indices.size(); i += 3)
+        planes.push_back(MakeFace(hp, hull.indices[i], hull.indices[i+1], hull.indices[i+2]));
+    float concavity = 0.0f;
+    for (i = 0; i < points.size(); ++i) {
+        float depth = FLT_MAX;
+        for (j = 0; j < planes.size(); ++j) {
+            float d = planes[j].d - Dot(planes[j].n, points[i]);
+            if (d < depth) depth = d;
+        }
+        if (depth > concavity) concavity = depth;
+    }
+    return concavity;
+}
+
+/**
+ * Approximate convex decomposition by recursively splitting the
+ * triangles in two along the longest axis until each part is close
+ * enough to its hull.
+ */
+inline void Decompose(vector<P3>& points, vector<unsigned int>& tris, unsigned int depth,
+                      float diag, CollisionOptions& options, vector<CollisionShape>& shapes) {
+    unsigned int i;
+    vector<P3> used, reduced;
+    set<unsigned int> seen;
+    for (i = 0; i < tris.size(); ++i)
+        if (seen.insert(tris[i]).second) used.push_back(points[tris[i]]);
+    Reduce(used, diag / options.resolution, reduced);
+
+    CollisionShape hull;
+    Hull(reduced, options.hullTolerance * diag, options.maxHullVertices, hull);
+    if (depth >= options.maxDepth || tris.size() < 6 ||
+        Concavity(reduced, hull) <= options.concavity * diag) {
+        shapes.push_back(hull);
+        return;
+    }
+
+    vector<P3> centroids;
+    for (i = 0; i < tris.size(); i += 3)
+        centroids.push_back((points[tris[i]] + points[tris[i+1]] + points[tris[i+2]]) * (1.0f / 3.0f));
+    P3 min, max;
+    Bounds(centroids, min, max);
+    P3 ext = max - min;
+    int axis = ext.x >= ext.y && ext.x >= ext.z ? 0 : (ext.y >= ext.z ? 1 : 2);
+    float split = 0.0f;
+    for (i = 0; i < centroids.size(); ++i)
+        split += Get(centroids[i], axis);
+    split /= centroids.size();
+
+    vector<unsigned int> left, right;
+    for (i = 0; i < centroids.size(); ++i) {
+        vector<unsigned int>& side = Get(centroids[i], axis) < split ? left : right;
+        side.push_back(tris[i*3]);
+        side.push_back(tris[i*3+1]);
+        side.push_back(tris[i*3+2]);
+    }
+    if (left.empty() || right.empty()) {
+        shapes.push_back(hull);
+        return;
+    }
+    Decompose(points, left,  depth + 1, diag, options, shapes);
+    Decompose(points, right, depth + 1, diag, options, shapes);
+}
+
+/**
+ * Weld vertices by clustering them on a grid. Triangles collapsed by
+ * the welding and duplicate triangles are removed.
+ */
+inline void Weld(vector<P3>& points, vector<unsigned int>& tris, float size, CollisionShape& out) {
+    unsigned int i;
+    P3 min, max;
+    Bounds(points, min, max);
+    map<Cell, unsigned int> cells;
+    vector<P3> sum;
+    vector<unsigned int> count, remap(points.size());
+    for (i = 0; i < points.size(); ++i) {
+        Cell c = size > 0.0f ? CellOf(points[i], min, size) : make_pair((int)i, make_pair(0, 0));
+        map<Cell, unsigned int>::iterator itr = cells.find(c);
+        if (itr == cells.end()) {
+            itr = cells.insert(make_pair(c, (unsigned int)sum.size())).first;
+            sum.push_back(P3());
+            count.push_back(0);
+        }
+        sum[itr->second] = sum[itr->second] + points[i];
+        count[itr->second]++;
+        remap[i] = itr->second;
+    }
+
+    vector<unsigned int> used(sum.size(), 0xFFFFFFFF);
+    set<pair<unsigned int, pair<unsigned int, unsigned int> > > seen;
+    for (i = 0; i < tris.size(); i += 3) {
+        unsigned int v[3] = { remap[tris[i]], remap[tris[i+1]], remap[tris[i+2]] };
+        if (v[0] == v[1] || v[1] == v[2] || v[2] == v[0]) continue;
+        unsigned int s[3] = { v[0], v[1], v[2] };
+        std::sort(s, s + 3);
+        if (!seen.insert(make_pair(s[0], make_pair(s[1], s[2]))).second) continue;
+        for (unsigned int j = 0; j < 3; ++j) {
+            if (used[v[j]] == 0xFFFFFFFF) {
+                used[v[j]] = out.vertices.size() / 3;
+                P3 p = sum[v[j]] * (1.0f / count[v[j]]);
+                out.vertices.push_back(p.x);
+                out.vertices.push_back(p.y);
+                out.vertices.push_back(p.z);
+            }
+            out.indices.push_back(used[v[j]]);
+        }
+    }
+}
+
+unsigned int CollisionOptions::Hash() const {
+    unsigned int h = 2166136261u;
+    const unsigned int values[] = {
+        (unsigned int)granularity, (unsigned int)mode, maxDepth, resolution,
+        (unsigned int)(concavity * 1e6f), (unsigned int)(weldDistance * 1e6f),
+        (unsigned int)(hullTolerance * 1e6f), maxHullVertices };
+    const unsigned char* bytes = (const unsigned char*)values;
+    for (unsigned int i = 0; i < sizeof(values); ++i) {
+        h ^= bytes[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * Worker thread taking jobs from a builder until none are left.
+ */
+class CollisionWorker : public Core::Thread {
+private:
+    CollisionProxyBuilder* builder;
+public:
+    CollisionWorker(CollisionProxyBuilder* builder)
+        : builder(builder) {}
+
+    void Run() {
+        CollisionProxyBuilder::Job job;
+        while (builder->Next(job))
+            builder->BuildJob(job);
+    }
+};
+
+CollisionProxyBuilder::CollisionProxyBuilder(CollisionOptions options)
+    : options(options), next(0), cancelled(false) {
+}
+
+CollisionProxyBuilder::~CollisionProxyBuilder() {
+    Wait();
+}
+
+void CollisionProxyBuilder::Add(CollisionProxyPtr proxy, vector<aiMesh*> meshes) {
+    Job job;
+    job.proxy = proxy;
+    job.meshes = meshes;
+    jobs.push_back(job);
+}
+
+bool CollisionProxyBuilder::Next(Job& job) {
+    lock.Lock();
+    bool found = !cancelled && next < jobs.size();
+    if (found) job = jobs[next++];
+    lock.Unlock();
+    return found;
+}
+
+/**
+ * Build the proxy of a job. Failures are reported on the proxy rather
+ * than escaping the worker thread.
+ */
+void CollisionProxyBuilder::BuildJob(Job& job) {
+    CollisionProxy& proxy = *job.proxy;
+    try {
+        Build(proxy, job.meshes, options);
+        return;
+    } catch (std::exception& e) {
+        proxy.error = e.what();
+    } catch (...) {
+        proxy.error = "unknown error";
+    }
+    proxy.shapes.clear();
+}
+
+/**
+ * Start the worker threads. All jobs must be added first.
+ */
+void CollisionProxyBuilder::Start() {
+    unsigned int n = options.threads < jobs.size() ? options.threads : jobs.size();
+    for (unsigned int i = 0; i < n; ++i) {
+        CollisionWorker* worker = new CollisionWorker(this);
+        workers.push_back(worker);
+        worker->Start();
+    }
+}
+
+/**
+ * Wait for all jobs to finish. Without worker threads the jobs are
+ * built here.
+ */
+void CollisionProxyBuilder::Wait() {
+    Job job;
+    while (workers.empty() && Next(job))
+        BuildJob(job);
+    for (unsigned int i = 0; i < workers.size(); ++i) {
+        workers[i]->Wait();
+        delete workers[i];
+    }
+    workers.clear();
+}
+
+/**
+ * Skip the jobs no worker has taken yet. Wait() still has to be called
+ * to join the workers on the jobs they are building.
+ */
+void CollisionProxyBuilder::Cancel() {
+    lock.Lock();
+    cancelled = true;
+    lock.Unlock();
+}
+
+void CollisionProxyBuilder::Build(CollisionProxy& proxy,
+                                  vector<aiMesh*>& meshes,
+                                  CollisionOptions& options) {
+    vector<P3> points;
+    vector<unsigned int> tris;
+    Gather(meshes, points, tris);
+    proxy.shapes.clear();
+    proxy.error.clear();
+    if (points.empty()) return;
+
+    P3 min, max;
+    Bounds(points, min, max);
+    float diag = Length(max - min);
+
+    if (options.mode == CollisionOptions::STATIC) {
+        CollisionShape soup;
+        Weld(points, tris, options.weldDistance * diag, soup);
+        proxy.shapes.push_back(soup);
+        proxy.type = CollisionProxy::TRIANGLE_SOUP;
+        return;
+    }
+
+    if (tris.empty()) {
+        // point meshes only get a hull.
+        vector<P3> reduced;
+        CollisionShape hull;
+        Reduce(points, diag / options.resolution, reduced);
+        Hull(reduced, options.hullTolerance * diag, options.maxHullVertices, hull);
+        proxy.shapes.push_back(hull);
+    }
+    else Decompose(points, tris, 0, diag, options, proxy.shapes);
+    proxy.type = proxy.shapes.size() > 1
+        ? CollisionProxy::CONVEX_DECOMPOSITION
+        : CollisionProxy::CONVEX_HULL;
+}
+
+// cache file layout version, bump on changes.
+static const unsigned int cacheVersion = 2;
+
+template <class T>
+inline void WriteValue(std::ofstream& out, T value) {
+    out.write((const char*)&value, sizeof(T));
+}
+
+template <class T>
+inline void WriteArray(std::ofstream& out, vector<T>& values) {
+    WriteValue(out, (unsigned int)values.size());
+    if (!values.empty()) out.write((const char*)&values[0], values.size() * sizeof(T));
+}
+
+template <class T>
+inline bool ReadValue(std::ifstream& in, T& value) {
+    in.read((char*)&value, sizeof(T));
+    return in.good();
+}
+
+/**
+ * Bytes left in a stream ending at end.
+ */
+inline unsigned long Remaining(std::ifstream& in, std::streampos end) {
+    std::streampos pos = in.tellg();
+    return in.good() && pos <= end ? (unsigned long)(end - pos) : 0;
+}
+
+/**
+ * Read an array, failing if its size does not fit in what is left of
+ * the stream so a corrupt cache cannot make us allocate arbitrarily.
+ */
+template <class T>
+inline bool ReadArray(std::ifstream& in, std::streampos end, vector<T>& values) {
+    unsigned int size;
+    if (!ReadValue(in, size) || size > Remaining(in, end) / sizeof(T)) 
+        return false;
+    values.resize(size);
+    if (size > 0) in.read((char*)&values[0], size * sizeof(T));
+    return in.good();
+}
+
+/**
+ * Check that a shape read from the cache can be used as is.
+ */
+inline bool ValidShape(CollisionShape& shape) {
+    if (shape.vertices.size() % 3 != 0 || shape.indices.size() % 3 != 0) 
+        return false;
+    unsigned int num = shape.vertices.size() / 3;
+    for (unsigned int i = 0; i < shape.indices.size(); ++i)
+        if (shape.indices[i] >= num) return false;
+    return true;
+}
+
+/**
+ * Write the proxies to a cache file tagged with a hash of the model
+ * contents and the options they were built with.
+ */
+bool CollisionProxyBuilder::Save(string file, unsigned int key,
+                                 CollisionOptions& options,
+                                 CollisionProxyList& proxies) {
+    std::ofstream out(file.c_str(), std::ios::out | std::ios::binary);
+    if (!out.good()) return false;
+    WriteValue(out, cacheVersion);
+    WriteValue(out, key);
+    WriteValue(out, options.Hash());
+    WriteValue(out, (unsigned int)proxies.size());
+    for (unsigned int i = 0; i < proxies.size(); ++i) {
+        CollisionProxy& p = *proxies[i];
+        vector<char> name(p.name.begin(), p.name.end());
+        WriteArray(out, name);
+        WriteValue(out, (unsigned int)p.type);
+        WriteValue(out, p.index);
+        WriteValue(out, (unsigned int)p.shapes.size());
+        for (unsigned int j = 0; j < p.shapes.size(); ++j) {
+            WriteArray(out, p.shapes[j].vertices);
+            WriteArray(out, p.shapes[j].indices);
+        }
+    }
+    return out.good();
+}
+
+/**
+ * Read proxies from a cache file. Fails if the cache is missing,
+ * corrupt or was built from other model contents or other options.
+ */
+bool CollisionProxyBuilder::Load(string file, unsigned int key,
+                                 CollisionOptions& options,
+                                 CollisionProxyList& proxies) {
+    std::ifstream in(file.c_str(), std::ios::in | std::ios::binary);
+    if (!in.good()) return false;
+    in.seekg(0, std::ios::end);
+    std::streampos end = in.tellg();
+    in.seekg(0, std::ios::beg);
+    // smallest proxy and shape records: sizes and fields, no data.
+    const unsigned long proxySize = 4 * sizeof(unsigned int);
+    const unsigned long shapeSize = 2 * sizeof(unsigned int);
+    unsigned int version, stamp, hash, count;
+    if (!ReadValue(in, version) || version != cacheVersion) return false;
+    if (!ReadValue(in, stamp)   || stamp != key)            return false;
+    if (!ReadValue(in, hash)    || hash != options.Hash())  return false;
+    if (!ReadValue(in, count) || count > Remaining(in, end) / proxySize) 
+        return false;
+    CollisionProxyList result;
+    for (unsigned int i = 0; i < count; ++i) {
+        CollisionProxyPtr p = CollisionProxyPtr(new CollisionProxy());
+        vector<char> name;
+        unsigned int type, shapes;
+        if (!ReadArray(in, end, name) || !ReadValue(in, type) ||
+            !ReadValue(in, p->index) || !ReadValue(in, shapes)) return false;
+        if (type > CollisionProxy::TRIANGLE_SOUP ||
+            shapes > Remaining(in, end) / shapeSize) return false;
+        p->name = string(name.begin(), name.end());
+        p->type = (CollisionProxy::Type)type;
+        p->shapes.resize(shapes);
+        for (unsigned int j = 0; j < shapes; ++j) {
+            if (!ReadArray(in, end, p->shapes[j].vertices) ||
+                !ReadArray(in, end, p->shapes[j].indices) ||
+                !ValidShape(p->shapes[j])) return false;
+        }
+        result.push_back(p);
+    }
+    proxies = result;
+    return true;
+}
+
+} // NS Resources
+} // NS OpenEngine
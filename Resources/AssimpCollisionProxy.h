@@ -0,0 +1,165 @@
+// Collision proxies generated at import time.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OE_ASSIMP_COLLISION_PROXY_H_
+#define _OE_ASSIMP_COLLISION_PROXY_H_
+
+#include <Geometry/Mesh.h>
+#include <Core/Mutex.h>
+
+#include <string>
+#include <vector>
+
+// assimp
+#include <aiScene.h>
+
+//forward declarations
+namespace OpenEngine {
+    namespace Scene {
+        class TransformationNode;
+    }
+namespace Resources {
+
+    using namespace Geometry;
+    using std::string;
+    using std::vector;
+
+    class CollisionWorker;
+
+/**
+ * Part of a collision proxy. Vertices are stored as x, y, z triples
+ * and the indices form triangles. A convex shape with no indices is
+ * degenerate, its vertices outline a flat polygon, a line segment or
+ * a single point.
+ */
+struct CollisionShape {
+    vector<float> vertices;
+    vector<unsigned int> indices;
+};
+
+/**
+ * Simplified collision geometry of a mesh or a scene node, in the
+ * local space of the mesh or node.
+ *
+ * @class CollisionProxy AssimpCollisionProxy.h "AssimpCollisionProxy.h"
+ */
+class CollisionProxy {
+public:
+    enum Type { CONVEX_HULL, CONVEX_DECOMPOSITION, TRIANGLE_SOUP };
+
+    Type type;
+    string name;
+    // mesh index, or node index in scene traversal order.
+    unsigned int index;
+    // set on per mesh proxies.
+    MeshPtr mesh;
+    // set on per node proxies.
+    Scene::TransformationNode* node;
+    vector<CollisionShape> shapes;
+    // set if the proxy could not be built, it has no shapes then.
+    string error;
+
+    CollisionProxy(): type(CONVEX_HULL), index(0), node(NULL) {}
+};
+
+typedef boost::shared_ptr<CollisionProxy> CollisionProxyPtr;
+typedef vector<CollisionProxyPtr> CollisionProxyList;
+
+/**
+ * Settings for collision proxy generation.
+ *
+ * Dynamic proxies are convex hulls, or an approximate convex
+ * decomposition if the mesh is concave. Static proxies are welded and
+ * simplified triangle soups. Distances are relative to the diagonal
+ * of the proxy bounding box.
+ */
+struct CollisionOptions {
+    enum Granularity { PER_MESH, PER_NODE };
+    enum Mode { DYNAMIC, STATIC };
+
+    bool enabled;
+    Granularity granularity;
+    Mode mode;
+    // max depth of a surface point inside a hull before it is split.
+    float concavity;
+    // max number of binary splits, at most 2^maxDepth hulls.
+    unsigned int maxDepth;
+    // hull points are reduced to one per cell of a grid this fine.
+    unsigned int resolution;
+    // points closer than this to a hull are left out of it.
+    float hullTolerance;
+    // max number of vertices of a hull, zero for no limit.
+    unsigned int maxHullVertices;
+    // vertices closer than this are welded in triangle soups.
+    float weldDistance;
+    // worker threads, zero builds on the loading thread.
+    unsigned int threads;
+    // store proxies next to the model file (<file>.collision).
+    bool cache;
+
+    CollisionOptions()
+        : enabled(false), granularity(PER_MESH), mode(DYNAMIC)
+        , concavity(0.05f), maxDepth(4), resolution(32)
+        , hullTolerance(0.002f), maxHullVertices(64)
+        , weldDistance(0.01f), threads(2), cache(true) {}
+
+    unsigned int Hash() const;
+};
+
+/**
+ * Builds collision proxies from Assimp meshes on worker threads.
+ *
+ * The meshes must stay alive until Wait() has returned, also after
+ * Cancel() as jobs already taken by a worker are finished.
+ *
+ * @class CollisionProxyBuilder AssimpCollisionProxy.h "AssimpCollisionProxy.h"
+ */
+class CollisionProxyBuilder {
+private:
+    struct Job {
+        CollisionProxyPtr proxy;
+        vector<aiMesh*> meshes;
+    };
+
+    CollisionOptions options;
+    vector<Job> jobs;
+    unsigned int next;
+    bool cancelled;
+    Core::Mutex lock;
+    vector<CollisionWorker*> workers;
+
+    bool Next(Job& job);
+    void BuildJob(Job& job);
+    friend class CollisionWorker;
+
+public:
+    CollisionProxyBuilder(CollisionOptions options);
+    ~CollisionProxyBuilder();
+
+    void Add(CollisionProxyPtr proxy, vector<aiMesh*> meshes);
+    void Start();
+    void Wait();
+    void Cancel();
+
+    static void Build(CollisionProxy& proxy,
+                      vector<aiMesh*>& meshes,
+                      CollisionOptions& options);
+
+    static bool Save(string file, unsigned int key,
+                     CollisionOptions& options,
+                     CollisionProxyList& proxies);
+    static bool Load(string file, unsigned int key,
+                     CollisionOptions& options,
+                     CollisionProxyList& proxies);
+};
+
+} // NS Resources
+} // NS OpenEngine
+
+#endif // _OE_ASSIMP_COLLISION_PROXY_H_
@@ -0,0 +1,437 @@
+// Streaming PLY point cloud resource.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Resources/AssimpPLYStreamResource.h>
+
+#include <Scene/SceneNode.h>
+#include <Scene/MeshNode.h>
+#include <Logging/Logger.h>
+#include <Resources/Exceptions.h>
+#include <Resources/DataBlock.h>
+#include <Geometry/GeometrySet.h>
+
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cfloat>
+#include <algorithm>
+
+namespace OpenEngine {
+namespace Resources {
+
+    using namespace Scene;
+    using namespace Geometry;
+
+enum PLYFormat { PLY_ASCII, PLY_BINARY_LE, PLY_BINARY_BE };
+
+enum PLYType { PLY_INVALID,
+               PLY_INT8, PLY_UINT8,
+               PLY_INT16, PLY_UINT16,
+               PLY_INT32, PLY_UINT32,
+               PLY_FLOAT32, PLY_FLOAT64 };
+
+// Attribute slots of a decoded vertex.
+enum { PLY_X, PLY_Y, PLY_Z,
+       PLY_NX, PLY_NY, PLY_NZ,
+       PLY_R, PLY_G, PLY_B,
+       PLY_ATTRIBS };
+
+inline PLYType ParseType(string t) {
+    if (t == "char"   || t == "int8")    return PLY_INT8;
+    if (t == "uchar"  || t == "uint8")   return PLY_UINT8;
+    if (t == "short"  || t == "int16")   return PLY_INT16;
+    if (t == "ushort" || t == "uint16")  return PLY_UINT16;
+    if (t == "int"    || t == "int32")   return PLY_INT32;
+    if (t == "uint"   || t == "uint32")  return PLY_UINT32;
+    if (t == "float"  || t == "float32") return PLY_FLOAT32;
+    if (t == "double" || t == "float64") return PLY_FLOAT64;
+    return PLY_INVALID;
+}
+
+inline unsigned int TypeSize(PLYType t) {
+    switch (t) {
+    case PLY_INT8:  case PLY_UINT8:   return 1;
+    case PLY_INT16: case PLY_UINT16:  return 2;
+    case PLY_INT32: case PLY_UINT32: case PLY_FLOAT32: return 4;
+    case PLY_FLOAT64: return 8;
+    default: return 0;
+    }
+}
+
+/**
+ * Decode a single binary value, swapping bytes if the file
+ * endianness differs from the host.
+ */
+inline float Decode(const char* p, PLYType t, bool swap) {
+    char b[8];
+    unsigned int i, n = TypeSize(t);
+    for (i = 0; i < n; ++i)
+        b[i] = swap ? p[n-1-i] : p[i];
+    switch (t) {
+    case PLY_INT8:    { signed char v;    memcpy(&v, b, n); return v; }
+    case PLY_UINT8:   { unsigned char v;  memcpy(&v, b, n); return v; }
+    case PLY_INT16:   { short v;          memcpy(&v, b, n); return v; }
+    case PLY_UINT16:  { unsigned short v; memcpy(&v, b, n); return v; }
+    case PLY_INT32:   { int v;            memcpy(&v, b, n); return (float)v; }
+    case PLY_UINT32:  { unsigned int v;   memcpy(&v, b, n); return (float)v; }
+    case PLY_FLOAT32: { float v;          memcpy(&v, b, n); return v; }
+    case PLY_FLOAT64: { double v;         memcpy(&v, b, n); return (float)v; }
+    default: return 0.0f;
+    }
+}
+
+/**
+ * Chunked reader of the vertex element of a PLY file.
+ */
+class PLYVertexReader {
+private:
+    std::ifstream in;
+    std::streampos dataStart;
+    vector<PLYType> types;
+    vector<int> slots;
+    vector<float> scales;
+    vector<char> raw;
+    unsigned int stride;
+    bool swap;
+
+    void AddProperty(PLYType type, string name) {
+        int slot = -1;
+        float scale = 1.0f;
+        if      (name == "x")  slot = PLY_X;
+        else if (name == "y")  slot = PLY_Y;
+        else if (name == "z")  slot = PLY_Z;
+        else if (name == "nx") slot = PLY_NX;
+        else if (name == "ny") slot = PLY_NY;
+        else if (name == "nz") slot = PLY_NZ;
+        else if (name == "red"   || name == "diffuse_red")   slot = PLY_R;
+        else if (name == "green" || name == "diffuse_green") slot = PLY_G;
+        else if (name == "blue"  || name == "diffuse_blue")  slot = PLY_B;
+        if (slot >= PLY_NX && slot <= PLY_NZ) hasNormals = true;
+        if (slot >= PLY_R) {
+            hasColors = true;
+            // integer colors are normalized to [0;1]
+            if (type == PLY_UINT8)  scale = 1.0f / 0xFF;
+            if (type == PLY_UINT16) scale = 1.0f / 0xFFFF;
+        }
+        types.push_back(type);
+        slots.push_back(slot);
+        scales.push_back(scale);
+        stride += TypeSize(type);
+    }
+
+public:
+    PLYFormat format;
+    unsigned long count, read;
+    bool hasNormals, hasColors, hasFaces;
+
+    PLYVertexReader()
+        : stride(0), swap(false), format(PLY_ASCII), count(0), read(0)
+        , hasNormals(false), hasColors(false), hasFaces(false) {}
+
+    /**
+     * Parse the header. Fails if the file is not a PLY file or the
+     * vertex element can not be streamed.
+     */
+    bool Open(string file) {
+        in.open(file.c_str(), std::ios::in | std::ios::binary);
+        if (!in.good()) return false;
+        string line, token;
+        std::getline(in, line);
+        if (line.compare(0, 3, "ply") != 0) return false;
+
+        unsigned int element = 0;
+        bool inVertex = false, foundVertex = false;
+        while (std::getline(in, line)) {
+            std::istringstream s(line);
+            s >> token;
+            if (token == "end_header") break;
+            else if (token == "format") {
+                s >> token;
+                if      (token == "ascii")                format = PLY_ASCII;
+                else if (token == "binary_little_endian") format = PLY_BINARY_LE;
+                else if (token == "binary_big_endian")    format = PLY_BINARY_BE;
+                else return false;
+            }
+            else if (token == "element") {
+                unsigned long n = 0;
+                s >> token >> n;
+                inVertex = (token == "vertex");
+                if (inVertex) {
+                    // we can only stream the vertices if they come first.
+                    if (element != 0) return false;
+                    foundVertex = true;
+                    count = n;
+                }
+                else if (token == "face" && n > 0) hasFaces = true;
+                ++element;
+            }
+            else if (token == "property" && inVertex) {
+                string type, name;
+                s >> type >> name;
+                PLYType t = ParseType(type);
+                // list properties on vertices are not supported.
+                if (t == PLY_INVALID) return false;
+                AddProperty(t, name);
+            }
+        }
+        if (!foundVertex || !in.good()) return false;
+        dataStart = in.tellg();
+
+        unsigned short one = 1;
+        bool little = *(unsigned char*)&one == 1;
+        swap = (format == PLY_BINARY_LE && !little) ||
+               (format == PLY_BINARY_BE && little);
+        return true;
+    }
+
+    void Rewind() {
+        in.clear();
+        in.seekg(dataStart);
+        read = 0;
+    }
+
+    /**
+     * Decode up to max vertices into dest, PLY_ATTRIBS floats per
+     * vertex. Returns the number of vertices read.
+     */
+    unsigned int Read(float* dest, unsigned int max) {
+        unsigned int i, j, n = count - read < max ? count - read : max;
+        if (n == 0) return 0;
+        memset(dest, 0, n * PLY_ATTRIBS * sizeof(float));
+        if (format == PLY_ASCII) {
+            double value;
+            for (i = 0; i < n; ++i) {
+                for (j = 0; j < types.size(); ++j) {
+                    if (!(in >> value)) return 0;
+                    if (slots[j] >= 0)
+                        dest[i * PLY_ATTRIBS + slots[j]] = value * scales[j];
+                }
+            }
+        }
+        else {
+            raw.resize(n * stride);
+            in.read(&raw[0], n * stride);
+            if ((unsigned int)in.gcount() != n * stride) return 0;
+            const char* p = &raw[0];
+            for (i = 0; i < n; ++i) {
+                for (j = 0; j < types.size(); ++j) {
+                    if (slots[j] >= 0)
+                        dest[i * PLY_ATTRIBS + slots[j]] = Decode(p, types[j], swap) * scales[j];
+                    p += TypeSize(types[j]);
+                }
+            }
+        }
+        read += n;
+        return n;
+    }
+
+    /**
+     * Size in bytes of a vertex in the file, or of a decoded vertex
+     * for ascii files.
+     */
+    unsigned int VertexSize() {
+        if (format == PLY_ASCII || stride == 0)
+            return PLY_ATTRIBS * sizeof(float);
+        return stride;
+    }
+};
+
+/**
+ * True if the position of a decoded vertex is finite. NaN and infinite
+ * coordinates can not be placed in a bucket.
+ */
+inline bool FinitePoint(const float* v) {
+    for (unsigned int j = PLY_X; j < PLY_X + 3; ++j) {
+        if (!(v[j] >= -FLT_MAX && v[j] <= FLT_MAX)) return false;
+    }
+    return true;
+}
+
+/**
+ * Resource constructor.
+ */
+AssimpPLYStreamResource::AssimpPLYStreamResource(string file,
+                                                 unsigned int chunkSize,
+                                                 unsigned int bucketSize,
+                                                 unsigned int gridSize)
+    : file(file), root(NULL), chunkSize(chunkSize)
+    , bucketSize(bucketSize), gridSize(gridSize), numPoints(0) {
+    // keep the buckets indexable by 16 bit indices.
+    if (this->bucketSize == 0 || this->bucketSize >= 0xFFFF) this->bucketSize = 0xFFFE;
+    if (this->gridSize == 0) this->gridSize = 1;
+}
+
+/**
+ * Resource destructor.
+ */
+AssimpPLYStreamResource::~AssimpPLYStreamResource() {
+    Unload();
+}
+
+/**
+ * Check if a file is a PLY point cloud that can be streamed.
+ */
+bool AssimpPLYStreamResource::CanStream(string file) {
+    PLYVertexReader reader;
+    return reader.Open(file) && !reader.hasFaces;
+}
+
+void AssimpPLYStreamResource::Load() {
+    if (root) return;
+
+    PLYVertexReader reader;
+    if (!reader.Open(file) || reader.hasFaces) {
+        Error("can not stream " + file);
+        return;
+    }
+
+    unsigned int i, j, n;
+    unsigned int chunkVerts = chunkSize / reader.VertexSize();
+    if (chunkVerts == 0) chunkVerts = 1;
+    vector<float> chunk(chunkVerts * PLY_ATTRIBS);
+
+    // First pass: find the bounding box.
+    float min[3] = {  FLT_MAX,  FLT_MAX,  FLT_MAX };
+    float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    unsigned int skipped = 0;
+    while ((n = reader.Read(&chunk[0], chunkVerts)) > 0) {
+        for (i = 0; i < n; ++i) {
+            float* v = &chunk[i * PLY_ATTRIBS];
+            if (!FinitePoint(v)) {
+                ++skipped;
+                continue;
+            }
+            for (j = 0; j < 3; ++j) {
+                if (v[j] < min[j]) min[j] = v[j];
+                if (v[j] > max[j]) max[j] = v[j];
+            }
+        }
+    }
+    if (reader.read != reader.count) {
+        Error("unexpected end of vertex data in " + file);
+        return;
+    }
+
+    material = MaterialPtr(new Material("PointCloud"));
+    root = new SceneNode();
+    root->SetInfo(file);
+
+    // Second pass: sort the points into buckets and emit full buckets.
+    float scale[3];
+    for (j = 0; j < 3; ++j)
+        scale[j] = max[j] > min[j] ? gridSize / (max[j] - min[j]) : 0.0f;
+    unsigned int buckets = gridSize * gridSize * gridSize;
+    vector<vector<float> > pos(buckets), norm(buckets), col(buckets);
+
+    reader.Rewind();
+    while ((n = reader.Read(&chunk[0], chunkVerts)) > 0) {
+        for (i = 0; i < n; ++i) {
+            float* v = &chunk[i * PLY_ATTRIBS];
+            if (!FinitePoint(v)) continue;
+            unsigned int cell[3];
+            for (j = 0; j < 3; ++j) {
+                cell[j] = (unsigned int)((v[j] - min[j]) * scale[j]);
+                if (cell[j] >= gridSize) cell[j] = gridSize - 1;
+            }
+            unsigned int b = (cell[2] * gridSize + cell[1]) * gridSize + cell[0];
+            pos[b].insert(pos[b].end(), v + PLY_X, v + PLY_X + 3);
+            if (reader.hasNormals)
+                norm[b].insert(norm[b].end(), v + PLY_NX, v + PLY_NX + 3);
+            if (reader.hasColors)
+                col[b].insert(col[b].end(), v + PLY_R, v + PLY_R + 3);
+            if (pos[b].size() == bucketSize * 3)
+                AddMesh(pos[b], norm[b], col[b]);
+        }
+    }
+    if (reader.read != reader.count) {
+        // drop the partial scene so the load can be retried.
+        delete root;
+        root = NULL;
+        Error("unexpected end of vertex data in " + file);
+        return;
+    }
+    for (i = 0; i < buckets; ++i) {
+        if (!pos[i].empty()) AddMesh(pos[i], norm[i], col[i]);
+    }
+    numPoints = reader.count - skipped;
+    logger.info << "Assimp: streamed " << numPoints << " points from "
+                << file << logger.end;
+    if (skipped > 0)
+        logger.warning << "Assimp: skipped " << skipped 
+                       << " points with non-finite coordinates in " << file << logger.end;
+}
+
+/**
+ * Emit a bucket as a point mesh and clear it.
+ */
+void AssimpPLYStreamResource::AddMesh(vector<float>& pos, vector<float>& norm, vector<float>& col) {
+    unsigned int i, num = pos.size() / 3;
+
+    float* dest = new float[3 * num];
+    std::copy(pos.begin(), pos.end(), dest);
+    Float3DataBlockPtr p = Float3DataBlockPtr(new DataBlock<3,float>(num, dest));
+
+    Float3DataBlockPtr n;
+    if (!norm.empty()) {
+        dest = new float[3 * num];
+        std::copy(norm.begin(), norm.end(), dest);
+        n = Float3DataBlockPtr(new DataBlock<3,float>(num, dest));
+    }
+
+    Float3DataBlockPtr c;
+    if (!col.empty()) {
+        dest = new float[3 * num];
+        std::copy(col.begin(), col.end(), dest);
+        c = Float3DataBlockPtr(new DataBlock<3,float>(num, dest));
+    }
+
+    IDataBlockList texc;
+    GeometrySetPtr gs = GeometrySetPtr(new GeometrySet(p, n, texc, c));
+
+    unsigned int* indexArr = new unsigned int[num];
+    unsigned short* indices16 = new unsigned short[num];
+    for (i = 0; i < num; ++i) {
+        indexArr[i] = i;
+        indices16[i] = i;
+    }
+    IndicesPtr index = IndicesPtr(new Indices(num, indexArr));
+    MeshPtr prim = MeshPtr(new Mesh(index, POINTS, gs, material));
+    prim->indices = IDataBlockPtr(new DataBlock<1, unsigned short>(num, indices16, INDEX_ARRAY));
+
+    root->AddNode(new MeshNode(prim));
+
+    pos.clear();
+    norm.clear();
+    col.clear();
+}
+
+void AssimpPLYStreamResource::Unload() {
+    if (!root) return;
+    root = NULL;
+}
+
+ISceneNode* AssimpPLYStreamResource::GetSceneNode() {
+    return root;
+}
+
+/**
+ * Number of points streamed by the last load, not counting skipped
+ * points.
+ */
+unsigned long AssimpPLYStreamResource::GetNumPoints() {
+    return numPoints;
+}
+
+void AssimpPLYStreamResource::Error(string msg) {
+    logger.error << "Assimp: " << msg << logger.end;
+    throw new ResourceException("Assimp: " + msg);
+}
+
+} // NS Resources
+} // NS OpenEngine
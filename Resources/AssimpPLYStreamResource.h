@@ -0,0 +1,75 @@
+// Streaming PLY point cloud resource.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OE_ASSIMP_PLY_STREAM_RESOURCE_H_
+#define _OE_ASSIMP_PLY_STREAM_RESOURCE_H_
+
+#include <Resources/IModelResource.h>
+#include <Geometry/Mesh.h>
+#include <Geometry/Material.h>
+
+#include <string>
+#include <vector>
+
+//forward declarations
+namespace OpenEngine {
+    namespace Scene {
+        class ISceneNode;
+    }
+namespace Resources {
+
+    using namespace Geometry;
+    using std::string;
+    using std::vector;
+
+/**
+ * Streaming loader for large PLY point clouds.
+ *
+ * The file is read twice in chunks of a fixed number of bytes, first
+ * to find the bounding box and then to sort the points into a regular
+ * grid of buckets. A bucket is emitted as a point Mesh with 16 bit
+ * indices whenever it holds bucketSize vertices, so the memory used
+ * besides the resulting meshes is bounded by the chunk and bucket
+ * sizes rather than the file size. No post processing is done.
+ *
+ * Only binary and ascii files where the vertex element comes first
+ * and no faces are present can be streamed, see CanStream().
+ *
+ * @class AssimpPLYStreamResource AssimpPLYStreamResource.h "AssimpPLYStreamResource.h"
+ */
+class AssimpPLYStreamResource : public IModelResource {
+private:
+    string file;
+    ISceneNode* root;
+    unsigned int chunkSize, bucketSize, gridSize;
+    unsigned long numPoints;
+
+    MaterialPtr material;
+
+    void Error(string msg);
+    void AddMesh(vector<float>& pos, vector<float>& norm, vector<float>& col);
+
+public:
+    AssimpPLYStreamResource(string file,
+                            unsigned int chunkSize = 1 << 20,
+                            unsigned int bucketSize = 0x4000,
+                            unsigned int gridSize = 4);
+    ~AssimpPLYStreamResource();
+    void Load();
+    void Unload();
+    ISceneNode* GetSceneNode();
+    unsigned long GetNumPoints();
+
+    static bool CanStream(string file);
+};
+
+} // NS Resources
+} // NS OpenEngine
+
+#endif // _OE_ASSIMP_PLY_STREAM_RESOURCE_H_
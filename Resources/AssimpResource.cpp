@@ -9,6 +9,7 @@
 //--------------------------------------------------------------------
 
 #include <Resources/AssimpResource.h>
+#include <Resources/AssimpPLYStreamResource.h>
 
 #include <Scene/SceneNode.h>
 #include <Logging/Logger.h>
@@ -29,6 +30,15 @@
 #include <Scene/AnimatedTransformationNode.h>
 #include <Scene/AnimatedMeshNode.h>
 
+#include <Core/Thread.h>
+#include <Core/Mutex.h>
+#include <Utils/Timer.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <cctype>
+#include <ctime>
+#include <fstream>
 
 namespace OpenEngine {
 namespace Resources {
@@ -37,10 +47,343 @@ namespace Resources {
     using namespace Geometry;
     using namespace Animations;
 
+// And have it read the given file with some example postprocessing
+// Usually - if speed is not the most important aspect for you - you'll 
+// propably to request more postprocessing than we do in this example.
+static const unsigned int importFlags = 
+    aiProcess_CalcTangentSpace       | 
+    //aiProcess_FlipUVs                |
+    //aiProcess_FlipWindingOrder       |
+    //aiProcess_MakeLeftHanded         |
+    aiProcess_Triangulate            |
+    aiProcess_JoinIdenticalVertices  |
+    aiProcess_GenSmoothNormals       |
+    aiProcess_SortByPType;
+
+/**
+ * Size of a file in bytes, or zero if it can not be stat'ed.
+ */
+inline unsigned long FileSize(string file) {
+    struct stat s;
+    if (stat(file.c_str(), &s) != 0) return 0;
+    return (unsigned long)s.st_size;
+}
+
+// FNV-1a hashing of the imported data used to diff reloaded scenes.
+inline unsigned int HashBytes(const void* data, unsigned int size, unsigned int hash) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (unsigned int i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+template <class T>
+inline unsigned int HashValue(T value, unsigned int hash) {
+    return HashBytes(&value, sizeof(T), hash);
+}
+
+inline unsigned int HashFile(string file) {
+    std::ifstream in(file.c_str(), std::ios::binary);
+    char buf[0x10000];
+    unsigned int h = 2166136261u;
+    while (in) {
+        in.read(buf, sizeof(buf));
+        h = HashBytes(buf, (unsigned int)in.gcount(), h);
+    }
+    return h;
+}
+
+/**
+ * Stamp of a file, or a zero stamp if it can not be stat'ed.
+ */
+inline AssimpFileStamp StampFile(string file) {
+    AssimpFileStamp stamp;
+    struct stat s;
+    if (stat(file.c_str(), &s) != 0) return stamp;
+    stamp.mtime = (long)s.st_mtime;
+    stamp.size = (unsigned long)s.st_size;
+#if defined(__APPLE__)
+    stamp.nsec = (long)s.st_mtimespec.tv_nsec;
+#elif defined(__linux__)
+    stamp.nsec = (long)s.st_mtim.tv_nsec;
+#endif
+    if (stamp.mtime >= (long)time(NULL) - 1)
+        stamp.hash = HashFile(file);
+    return stamp;
+}
+
+/**
+ * True if the file stamped as current has been modified since it
+ * was stamped as last.
+ */
+inline bool StampChanged(AssimpFileStamp& current, AssimpFileStamp& last, string file) {
+    if (current.mtime != last.mtime || current.nsec != last.nsec || 
+        current.size != last.size) 
+        return true;
+    if (last.hash == 0) return false;
+    if (current.hash == 0) current.hash = HashFile(file);
+    return current.hash != last.hash;
+}
+
+inline unsigned int HashMesh(aiMesh* m) {
+    unsigned int j, h = 2166136261u;
+    unsigned int num = m->mNumVertices;
+    h = HashValue(m->mPrimitiveTypes, h);
+    h = HashValue(m->mMaterialIndex, h);
+    h = HashValue(num, h);
+    h = HashBytes(m->mVertices, num * sizeof(aiVector3D), h);
+    if (m->HasNormals())
+        h = HashBytes(m->mNormals, num * sizeof(aiVector3D), h);
+    if (m->HasTangentsAndBitangents()) {
+        h = HashBytes(m->mTangents, num * sizeof(aiVector3D), h);
+        h = HashBytes(m->mBitangents, num * sizeof(aiVector3D), h);
+    }
+    for (j = 0; j < m->GetNumUVChannels(); ++j) {
+        h = HashValue(m->mNumUVComponents[j], h);
+        h = HashBytes(m->mTextureCoords[j], num * sizeof(aiVector3D), h);
+    }
+    for (j = 0; j < m->GetNumColorChannels(); ++j)
+        h = HashBytes(m->mColors[j], num * sizeof(aiColor4D), h);
+    h = HashValue(m->mNumFaces, h);
+    for (j = 0; j < m->mNumFaces; ++j)
+        h = HashBytes(m->mFaces[j].mIndices, 
+                      m->mFaces[j].mNumIndices * sizeof(unsigned int), h);
+    h = HashValue(m->mNumBones, h);
+    for (j = 0; j < m->mNumBones; ++j) {
+        aiBone* b = m->mBones[j];
+        h = HashBytes(b->mName.data, b->mName.length, h);
+        h = HashValue(b->mOffsetMatrix, h);
+        h = HashBytes(b->mWeights, b->mNumWeights * sizeof(aiVertexWeight), h);
+    }
+    return h;
+}
+
+inline unsigned int HashMaterial(aiMaterial* m) {
+    unsigned int h = 2166136261u;
+    for (unsigned int i = 0; i < m->mNumProperties; ++i) {
+        aiMaterialProperty* p = m->mProperties[i];
+        h = HashBytes(p->mKey.data, p->mKey.length, h);
+        h = HashValue(p->mSemantic, h);
+        h = HashValue(p->mIndex, h);
+        h = HashBytes(p->mData, p->mDataLength, h);
+    }
+    return h;
+}
+
+/**
+ * Hash of the node hierarchy: node names, mesh references and
+ * children, but not the node transformations.
+ */
+inline unsigned int HashNode(aiNode* node, unsigned int h) {
+    unsigned int i;
+    h = HashBytes(node->mName.data, node->mName.length, h);
+    h = HashValue(node->mNumMeshes, h);
+    h = HashBytes(node->mMeshes, node->mNumMeshes * sizeof(unsigned int), h);
+    h = HashValue(node->mNumChildren, h);
+    for (i = 0; i < node->mNumChildren; ++i)
+        h = HashNode(node->mChildren[i], h);
+    return h;
+}
+
+/**
+ * Hash of the animation channels.
+ */
+inline unsigned int HashAnimations(const aiScene* scene) {
+    unsigned int i, j, h = 2166136261u;
+    h = HashValue(scene->mNumAnimations, h);
+    for (i = 0; i < scene->mNumAnimations; ++i) {
+        aiAnimation* anim = scene->mAnimations[i];
+        h = HashBytes(anim->mName.data, anim->mName.length, h);
+        h = HashValue(anim->mDuration, h);
+        h = HashValue(anim->mTicksPerSecond, h);
+        h = HashValue(anim->mNumChannels, h);
+        for (j = 0; j < anim->mNumChannels; ++j) {
+            aiNodeAnim* c = anim->mChannels[j];
+            h = HashBytes(c->mNodeName.data, c->mNodeName.length, h);
+            h = HashValue(c->mNumPositionKeys, h);
+            h = HashBytes(c->mPositionKeys, c->mNumPositionKeys * sizeof(aiVectorKey), h);
+            h = HashValue(c->mNumRotationKeys, h);
+            h = HashBytes(c->mRotationKeys, c->mNumRotationKeys * sizeof(aiQuatKey), h);
+            h = HashValue(c->mNumScalingKeys, h);
+            h = HashBytes(c->mScalingKeys, c->mNumScalingKeys * sizeof(aiVectorKey), h);
+        }
+    }
+    return h;
+}
+
+inline void HashScene(const aiScene* scene, AssimpSceneHashes& hashes) {
+    unsigned int i;
+    hashes.meshes.clear();
+    for (i = 0; i < scene->mNumMeshes; ++i)
+        hashes.meshes.push_back(HashMesh(scene->mMeshes[i]));
+    hashes.materials.clear();
+    for (i = 0; i < scene->mNumMaterials; ++i)
+        hashes.materials.push_back(HashMaterial(scene->mMaterials[i]));
+    hashes.structure = HashNode(scene->mRootNode, 2166136261u);
+    hashes.animation = HashAnimations(scene);
+}
+
+/**
+ * Key of the collision cache: proxies depend on the mesh contents and
+ * on which nodes hold which meshes only.
+ */
+inline unsigned int CollisionKey(const AssimpSceneHashes& hashes) {
+    unsigned int h = HashValue(hashes.structure, 2166136261u);
+    for (unsigned int i = 0; i < hashes.meshes.size(); ++i)
+        h = HashValue(hashes.meshes[i], h);
+    return h;
+}
+
+/**
+ * Take a part of the previous scene with the given hash, preferring
+ * the one at the same index, and clear it so it is used once only.
+ * Returns an empty pointer if there is none.
+ */
+template <class T>
+inline T TakeSpare(vector<T>& spare, vector<unsigned int>& spareHashes,
+                   unsigned int index, unsigned int hash) {
+    T found;
+    unsigned int i, n = spare.size() < spareHashes.size() ? spare.size() : spareHashes.size();
+    if (index < n && spare[index] && spareHashes[index] == hash) i = index;
+    else for (i = 0; i < n && (!spare[i] || spareHashes[i] != hash); ++i);
+    if (i == n) return found;
+    found = spare[i];
+    spare[i].reset();
+    return found;
+}
+
+/**
+ * Microseconds since the previous lap of the timer.
+ */
+inline unsigned int Lap(Utils::Timer& timer, unsigned int& last) {
+    unsigned int now = timer.GetElapsedIntervals(1);
+    unsigned int lap = now - last;
+    last = now;
+    return lap;
+}
+
+/**
+ * Collect the meshes of each node holding any, in the same order as
+ * ReadNode creates transformation nodes. Only nodes holding a changed
+ * mesh get a proxy.
+ */
+inline void AddNodeProxies(const aiScene* scene, aiNode* node, unsigned int& index,
+                           vector<bool>& changed, CollisionProxyBuilder* builder, 
+                           CollisionProxyList& proxies) {
+    unsigned int i;
+    bool any = false;
+    for (i = 0; i < node->mNumMeshes; ++i)
+        any = any || changed[node->mMeshes[i]];
+    if (any) {
+        vector<aiMesh*> ms;
+        for (i = 0; i < node->mNumMeshes; ++i)
+            ms.push_back(scene->mMeshes[node->mMeshes[i]]);
+        CollisionProxyPtr proxy = CollisionProxyPtr(new CollisionProxy());
+        proxy->name = node->mName.data;
+        proxy->index = index;
+        builder->Add(proxy, ms);
+        proxies.push_back(proxy);
+    }
+    ++index;
+    for (i = 0; i < node->mNumChildren; ++i)
+        AddNodeProxies(scene, node->mChildren[i], index, changed, builder, proxies);
+}
+
+/**
+ * Add the proxies of the changed meshes of a scene to a builder. The
+ * proxies are ordered by index.
+ */
+inline void AddCollisionProxies(const aiScene* scene, CollisionOptions& options,
+                                vector<bool>& changed, CollisionProxyBuilder* builder,
+                                CollisionProxyList& proxies) {
+    if (options.granularity == CollisionOptions::PER_MESH) {
+        for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
+            if (!changed[i]) continue;
+            CollisionProxyPtr proxy = CollisionProxyPtr(new CollisionProxy());
+            proxy->name = scene->mMeshes[i]->mName.data;
+            proxy->index = i;
+            builder->Add(proxy, vector<aiMesh*>(1, scene->mMeshes[i]));
+            proxies.push_back(proxy);
+        }
+    }
+    else {
+        unsigned int index = 0;
+        AddNodeProxies(scene, scene->mRootNode, index, changed, builder, proxies);
+    }
+}
+
+/**
+ * Background import of a modified model file. The collision proxies
+ * of the changed meshes are rebuilt here as well, or all of them if
+ * the node hierarchy or the options changed. A hash only import just
+ * hashes the scene of a resource loaded before it was watched.
+ */
+class AssimpImportThread : public Core::Thread {
+private:
+    Core::Mutex lock;
+    bool done;
+
+    void BuildCollisionProxies() {
+        allProxies = allProxies ||
+            hashes.structure != oldHashes.structure ||
+            hashes.meshes.size() != oldHashes.meshes.size();
+        if (options.cache &&
+            CollisionProxyBuilder::Load(file + ".collision", CollisionKey(hashes), 
+                                        options, proxies)) {
+            allProxies = cachedProxies = true;
+            return;
+        }
+        vector<bool> changed(scene->mNumMeshes, true);
+        for (unsigned int i = 0; !allProxies && i < scene->mNumMeshes; ++i)
+            changed[i] = hashes.meshes[i] != oldHashes.meshes[i];
+        CollisionProxyBuilder builder(options);
+        AddCollisionProxies(scene, options, changed, &builder, proxies);
+        builder.Start();
+        builder.Wait();
+    }
+public:
+    string file;
+    Assimp::Importer importer;
+    const aiScene* scene;
+    AssimpSceneHashes hashes, oldHashes;
+
+    CollisionOptions options;
+    // rebuilt proxies, all of them if allProxies is set.
+    CollisionProxyList proxies;
+    bool allProxies, cachedProxies;
+    bool hashOnly;
+
+    AssimpImportThread(string file, AssimpSceneHashes oldHashes, 
+                       CollisionOptions options, bool allProxies)
+        : done(false), file(file), scene(NULL), oldHashes(oldHashes)
+        , options(options), allProxies(allProxies), cachedProxies(false)
+        , hashOnly(false) {}
+
+    void Run() {
+        scene = importer.ReadFile(file, importFlags);
+        if (scene) {
+            HashScene(scene, hashes);
+            if (options.enabled) BuildCollisionProxies();
+        }
+        lock.Lock();
+        done = true;
+        lock.Unlock();
+    }
+
+    bool IsDone() {
+        lock.Lock();
+        bool d = done;
+        lock.Unlock();
+        return d;
+    }
+};
+
 /**
  * Get the file extension for Assimp files.
  */
-AssimpPlugin::AssimpPlugin() {
+AssimpPlugin::AssimpPlugin(): streamSize(64 << 20) {
     this->AddExtension("dae");
     this->AddExtension("obj");
     this->AddExtension("3ds");
@@ -55,19 +398,38 @@ AssimpPlugin::AssimpPlugin() {
  * Create a Assimp resource.
  */
 IModelResourcePtr AssimpPlugin::CreateResource(string file) {
+    string ext = file.size() > 4 ? file.substr(file.size() - 4) : "";
+    for (unsigned int i = 0; i < ext.size(); ++i) ext[i] = tolower(ext[i]);
+    if (ext == ".ply" && FileSize(file) >= streamSize && 
+        AssimpPLYStreamResource::CanStream(file))
+        return IModelResourcePtr(new AssimpPLYStreamResource(file));
     return IModelResourcePtr(new AssimpResource(file));
 }
 
+/**
+ * Set the minimum size in bytes of PLY point clouds that are streamed.
+ */
+void AssimpPlugin::SetStreamThreshold(unsigned long bytes) {
+    streamSize = bytes;
+}
+
 /**
  * Resource constructor.
  */
-AssimpResource::AssimpResource(string file): file(file), root(NULL), animRoot(NULL) {
+AssimpResource::AssimpResource(string file)
+    : file(file), root(NULL), animRoot(NULL)
+    , watch(false), pollInterval(500000), sincePoll(0)
+    , reloader(NULL), reloadPending(false), proxyOptions(0) {
 }
 
 /**
  * Resource destructor.
  */
 AssimpResource::~AssimpResource() {
+    if (reloader) {
+        reloader->Wait();
+        delete reloader;
+    }
     Unload();
 }
 
@@ -78,18 +440,11 @@ void AssimpResource::Load() {
     // Create an instance of the Importer class
     Assimp::Importer importer;
     
-    // And have it read the given file with some example postprocessing
-    // Usually - if speed is not the most important aspect for you - you'll 
-    // propably to request more postprocessing than we do in this example.
-    const aiScene* scene = importer.ReadFile(file, 
-                                             aiProcess_CalcTangentSpace       | 
-                                             //aiProcess_FlipUVs                |
-                                             //aiProcess_FlipWindingOrder       |
-                                             //aiProcess_MakeLeftHanded         |
-                                             aiProcess_Triangulate            |
-                                             aiProcess_JoinIdenticalVertices  |
-                                             aiProcess_GenSmoothNormals       |
-                                             aiProcess_SortByPType);
+    Utils::Timer timer;
+    timer.Start();
+    const aiScene* scene = importer.ReadFile(file, importFlags);
+    stats = AssimpLoadStatistics();
+    stats.importTime = timer.GetElapsedIntervals(1);
     
     // If the import failed, report it
     if(!scene){
@@ -98,16 +453,378 @@ void AssimpResource::Load() {
     }
     root = new SceneNode();
     
-    // Now we can access the file's contents. 
-    ReadMaterials(scene->mMaterials, scene->mNumMaterials);
-    ReadMeshes(scene->mMeshes, scene->mNumMeshes);
+    BuildScene(scene);
+    // We're done. Everything will be cleaned up by the importer destructor
+}
 
-    ReadScene(scene);
-    ReadAnimations(scene->mAnimations, scene->mNumAnimations);
-    ReadAnimatedMeshes(scene->mMeshes, scene->mNumMeshes);
+/**
+ * Build the scene below the root node. A rebuild of a reloaded scene
+ * reuses the parts of the previous scene set aside as spares and
+ * leaves the hashes and collision proxies to the caller.
+ */
+void AssimpResource::BuildScene(const aiScene* scene, bool rebuild) {
+    meshes.clear();
+    materials.clear();
+    transMap.clear();
+    meshMap.clear();
+    meshNodes.clear();
+    meshNodes.resize(scene->mNumMeshes);
+    nodeTrans.clear();
+    nodeParents.clear();
+    nodeScenes.clear();
+    nodeNames.clear();
+    animRoot = NULL;
+
+    // a rebuild is part of a reload, which is not in the statistics.
+    AssimpLoadStatistics rebuildStats;
+    AssimpLoadStatistics& st = rebuild ? rebuildStats : stats;
+    Utils::Timer timer;
+    unsigned int i, j, last = 0;
+    timer.Start();
+
+    // Remember what we build so a reload can be diffed against it. An
+    // unwatched scene is hashed on a background import once watched.
+    if (!rebuild) {
+        hashes = AssimpSceneHashes();
+        if (watch || reloader || collisionOptions.enabled) 
+            HashScene(scene, hashes);
+    }
+    st.hashTime = Lap(timer, last);
+
+    // Collision proxies are built by worker threads while we read the scene.
+    CollisionProxyBuilder* builder = NULL;
+    if (!rebuild) builder = StartCollisionProxies(scene);
+
+    try {
+        // Now we can access the file's contents. 
+        ReadMaterials(scene->mMaterials, scene->mNumMaterials);
+        st.materialTime = Lap(timer, last);
+        ReadMeshes(scene->mMeshes, scene->mNumMeshes);
+        st.meshTime = Lap(timer, last);
+
+        ReadScene(scene);
+        st.sceneTime = Lap(timer, last);
+        ReadAnimations(scene->mAnimations, scene->mNumAnimations);
+        st.animationTime = Lap(timer, last);
+        ReadAnimatedMeshes(scene->mMeshes, scene->mNumMeshes);
+        st.animatedMeshTime = Lap(timer, last);
+    } catch (...) {
+        // the workers read the scene, skip the remaining proxies and
+        // wait for the ones being built before it is released.
+        if (builder) {
+            builder->Cancel();
+            delete builder;
+        }
+        throw;
+    }
 
     if (animRoot) root->AddNode(animRoot);
-    // We're done. Everything will be cleaned up by the importer destructor
+
+    if (!rebuild) FinishCollisionProxies(builder);
+    st.collisionTime = Lap(timer, last);
+
+    st.numMeshes = scene->mNumMeshes;
+    st.numMaterials = scene->mNumMaterials;
+    st.numNodes = nodeTrans.size();
+    st.numVertices = st.numFaces = st.numKeys = 0;
+    for (i = 0; i < scene->mNumMeshes; ++i) {
+        st.numVertices += scene->mMeshes[i]->mNumVertices;
+        st.numFaces += scene->mMeshes[i]->mNumFaces;
+    }
+    for (i = 0; i < scene->mNumAnimations; ++i) {
+        aiAnimation* anim = scene->mAnimations[i];
+        for (j = 0; j < anim->mNumChannels; ++j) {
+            aiNodeAnim* channel = anim->mChannels[j];
+            st.numKeys += channel->mNumPositionKeys 
+                + channel->mNumRotationKeys 
+                + channel->mNumScalingKeys;
+        }
+    }
+
+}
+
+/**
+ * Watch the model file for modifications.
+ *
+ * The file is polled every interval microseconds when the resource
+ * is attached to the engine process event.
+ */
+void AssimpResource::Watch(bool enable, unsigned int interval) {
+    watch = enable;
+    pollInterval = interval;
+    sincePoll = 0;
+    if (!enable) return;
+    if (stamp.mtime == 0) stamp = StampFile(file);
+    // a scene loaded unwatched has no hashes to diff a reload against.
+    if (root && !reloader && hashes.structure == 0) {
+        reloader = new AssimpImportThread(file, hashes, CollisionOptions(), false);
+        reloader->hashOnly = true;
+        reloader->Start();
+    }
+}
+
+bool AssimpResource::IsWatched() {
+    return watch;
+}
+
+/**
+ * Start a background re-import of the model file. The result is
+ * applied on the next process event after the import has finished.
+ */
+void AssimpResource::Reload() {
+    if (reloader) {
+        // reload once the scene is hashed.
+        reloadPending = reloader->hashOnly;
+        return;
+    }
+    stamp = StampFile(file);
+    reloader = new AssimpImportThread(file, hashes, collisionOptions, 
+                                      proxyOptions != collisionOptions.Hash());
+    reloader->Start();
+}
+
+void AssimpResource::Handle(Core::ProcessEventArg arg) {
+    if (reloader) {
+        if (!reloader->IsDone()) return;
+        reloader->Wait();
+        if (reloader->hashOnly) {
+            if (reloader->scene) hashes = reloader->hashes;
+        }
+        else if (!reloader->scene) 
+            Warning("reload of " + file + " failed: " + reloader->importer.GetErrorString());
+        else if (root) {
+            PatchScene(reloader->scene, reloader->hashes);
+            UpdateCollisionProxies(reloader);
+        }
+        delete reloader;
+        reloader = NULL;
+        if (reloadPending) {
+            reloadPending = false;
+            Reload();
+        }
+        return;
+    }
+    if (!watch) return;
+    sincePoll += arg.approx;
+    if (sincePoll < pollInterval) return;
+    sincePoll = 0;
+    AssimpFileStamp current = StampFile(file);
+    // a missing file is most likely being re-exported, wait for it.
+    if (current.mtime == 0) return;
+    bool recent = current.hash != 0;
+    if (!StampChanged(current, stamp, file)) {
+        // stop hashing the contents once the stamp can be trusted.
+        if (!recent) stamp = current;
+        return;
+    }
+    Reload();
+}
+
+/**
+ * Start building the collision proxies of a scene. Returns NULL if
+ * proxies are disabled or could be read from the cache.
+ */
+CollisionProxyBuilder* AssimpResource::StartCollisionProxies(const aiScene* scene) {
+    collisionProxies.clear();
+    if (!collisionOptions.enabled) return NULL;
+    if (collisionOptions.cache &&
+        CollisionProxyBuilder::Load(file + ".collision", CollisionKey(hashes), 
+                                    collisionOptions, collisionProxies))
+        return NULL;
+
+    CollisionProxyBuilder* builder = new CollisionProxyBuilder(collisionOptions);
+    vector<bool> all(scene->mNumMeshes, true);
+    AddCollisionProxies(scene, collisionOptions, all, builder, collisionProxies);
+    builder->Start();
+    return builder;
+}
+
+/**
+ * Wait for the proxies, store them in the cache and associate them
+ * with the meshes or transformation nodes they belong to.
+ */
+void AssimpResource::FinishCollisionProxies(CollisionProxyBuilder* builder) {
+    if (builder) {
+        builder->Wait();
+        delete builder;
+        SaveCollisionProxies(collisionProxies, collisionOptions);
+    }
+    proxyOptions = collisionOptions.enabled ? collisionOptions.Hash() : 0;
+    LinkCollisionProxies(collisionOptions.granularity);
+}
+
+/**
+ * Merge the proxies rebuilt by the import thread into the current
+ * ones. Must be called after the reloaded scene has been patched.
+ */
+void AssimpResource::UpdateCollisionProxies(AssimpImportThread* reloader) {
+    CollisionProxyList& built = reloader->proxies;
+    if (!reloader->options.enabled)
+        collisionProxies.clear();
+    else if (reloader->allProxies)
+        collisionProxies = built;
+    else {
+        // both lists are ordered by index.
+        unsigned int i, j = 0;
+        for (i = 0; i < built.size(); ++i) {
+            while (j < collisionProxies.size() && 
+                   collisionProxies[j]->index < built[i]->index) ++j;
+            if (j < collisionProxies.size() && 
+                collisionProxies[j]->index == built[i]->index)
+                collisionProxies[j] = built[i];
+        }
+    }
+    if (!reloader->cachedProxies && !built.empty())
+        SaveCollisionProxies(built, reloader->options);
+    proxyOptions = reloader->options.enabled ? reloader->options.Hash() : 0;
+    LinkCollisionProxies(reloader->options.granularity);
+}
+
+/**
+ * Report the proxies that failed to build and store the current ones
+ * in the cache if none of them has failed, errors are not cached.
+ */
+void AssimpResource::SaveCollisionProxies(CollisionProxyList& built, 
+                                          CollisionOptions& options) {
+    unsigned int i;
+    for (i = 0; i < built.size(); ++i) {
+        if (built[i]->error.empty()) continue;
+        Warning("collision proxy " + built[i]->name + 
+                " of " + file + " failed: " + built[i]->error);
+    }
+    // a merged list may hold proxies that failed on an earlier load.
+    bool failed = false;
+    for (i = 0; i < collisionProxies.size(); ++i)
+        failed = failed || !collisionProxies[i]->error.empty();
+    if (options.cache && !failed &&
+        !CollisionProxyBuilder::Save(file + ".collision", CollisionKey(hashes), 
+                                     options, collisionProxies))
+        Warning("could not write collision cache for " + file);
+}
+
+/**
+ * Associate the proxies with the meshes or transformation nodes they
+ * belong to. The granularity must be the one the proxies were built
+ * with, which is not the current one if it was set during a reload.
+ */
+void AssimpResource::LinkCollisionProxies(CollisionOptions::Granularity granularity) {
+    for (unsigned int i = 0; i < collisionProxies.size(); ++i) {
+        CollisionProxyPtr proxy = collisionProxies[i];
+        if (granularity == CollisionOptions::PER_MESH) {
+            if (proxy->index < meshes.size()) proxy->mesh = meshes[proxy->index];
+        }
+        else if (proxy->index < nodeTrans.size()) 
+            proxy->node = nodeTrans[proxy->index];
+    }
+}
+
+/**
+ * Set how collision proxies are generated. Takes effect on the next
+ * load or reload.
+ */
+void AssimpResource::SetCollisionOptions(CollisionOptions options) {
+    collisionOptions = options;
+}
+
+CollisionOptions AssimpResource::GetCollisionOptions() {
+    return collisionOptions;
+}
+
+CollisionProxyList AssimpResource::GetCollisionProxies() {
+    return collisionProxies;
+}
+
+/**
+ * Timings and sizes of the last Load(). Reloads are not included.
+ */
+AssimpLoadStatistics AssimpResource::GetLoadStatistics() {
+    return stats;
+}
+
+/**
+ * True if a mesh that changed between two scenes is skinned.
+ */
+inline bool SkinnedMeshChanged(const aiScene* scene,
+                               AssimpSceneHashes& current, 
+                               AssimpSceneHashes& next) {
+    for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
+        if (next.meshes[i] != current.meshes[i] && scene->mMeshes[i]->HasBones())
+            return true;
+    return false;
+}
+
+/**
+ * Apply a re-imported scene to the current scene graph.
+ */
+void AssimpResource::PatchScene(const aiScene* scene, AssimpSceneHashes& newHashes) {
+    unsigned int i, j, index = 0;
+    // Animations refer to the transformation nodes and skinned meshes,
+    // so changed animations, skinned meshes and hierarchies rebuild the
+    // node and animation graph.
+    if (newHashes.structure != hashes.structure ||
+        newHashes.animation != hashes.animation ||
+        scene->mNumMeshes != meshes.size() ||
+        scene->mNumMaterials != materials.size() ||
+        (animRoot && SkinnedMeshChanged(scene, hashes, newHashes))) {
+        // deleting a node deletes the nodes below it.
+        if (animRoot) {
+            root->RemoveNode(animRoot);
+            delete animRoot;
+            animRoot = NULL;
+        }
+        spareMeshes = meshes;
+        spareMaterials = materials;
+        spareHashes = hashes;
+        ReleaseNodes();
+        unsigned int spares = spareTrans.size();
+
+        // the import thread has rebuilt the collision proxies.
+        hashes = newHashes;
+        BuildScene(scene, true);
+
+        unsigned int keptMeshes = 0, keptMaterials = 0, keptNodes = spares - spareTrans.size();
+        for (i = 0; i < spareMeshes.size(); ++i)
+            if (!spareMeshes[i]) ++keptMeshes;
+        for (i = 0; i < spareMaterials.size(); ++i)
+            if (!spareMaterials[i]) ++keptMaterials;
+        map<string, TransformationNode*>::iterator itr;
+        for (itr = spareTrans.begin(); itr != spareTrans.end(); ++itr)
+            delete itr->second;
+        spareTrans.clear();
+        spareMeshes.clear();
+        spareMaterials.clear();
+        spareHashes = AssimpSceneHashes();
+        logger.info << "Assimp: rebuilt scene of " << file << " (kept " 
+                    << keptMeshes << " meshes, " 
+                    << keptMaterials << " materials and "
+                    << keptNodes << " nodes)" << logger.end;
+        return;
+    }
+
+    PatchNode(scene->mRootNode, index);
+
+    unsigned int changedMaterials = 0;
+    for (i = 0; i < scene->mNumMaterials; ++i) {
+        if (newHashes.materials[i] == hashes.materials[i]) continue;
+        // Update the existing material so all meshes using it see the change.
+        *materials[i] = *ReadMaterial(scene->mMaterials[i]);
+        ++changedMaterials;
+    }
+
+    unsigned int changedMeshes = 0;
+    for (i = 0; i < scene->mNumMeshes; ++i) {
+        if (newHashes.meshes[i] == hashes.meshes[i]) continue;
+        MeshPtr mesh = ReadMesh(scene->mMeshes[i]);
+        meshes[i] = mesh;
+        for (j = 0; j < meshNodes[i].size(); ++j)
+            meshNodes[i][j]->SetMesh(mesh);
+        ++changedMeshes;
+    }
+
+    hashes = newHashes;
+    logger.info << "Assimp: reloaded " << file << " (" 
+                << changedMeshes << " meshes and " 
+                << changedMaterials << " materials changed)" << logger.end;
 }
 
 void AssimpResource::Unload() {
@@ -129,166 +846,177 @@ void AssimpResource::Warning(string msg) {
 }
 
 void AssimpResource::ReadMeshes(aiMesh** ms, unsigned int size) {
-    unsigned int i, j;
     //    logger.info << "meshCount: " << size << logger.end;
-    for (i = 0; i < size; ++i) {
+    for (unsigned int i = 0; i < size; ++i) {
         aiMesh* m = ms[i];
-        //cout << "MeshName:   " << m->mName.data << endl;
-        //cout << "numBones:   " << m->mNumBones << endl; 
-        for(unsigned int b=0; b<m->mNumBones; b++){
-            aiBone* bone = m->mBones[b];
-            //cout << "   bone: " << b << endl;
-            //cout << "   numWeights: " << bone->mNumWeights << endl;
-            //cout << "   [";
-            for(unsigned int v=0; v<bone->mNumWeights; v++){
-                //cout << bone->mWeights[v].mVertexId << ", ";
-            }
-            //cout << "]" << endl;
+        // an animated mesh deforms the geometry of its mesh, so skinned
+        // meshes are always read again.
+        MeshPtr prim;
+        if (!m->HasBones() && i < hashes.meshes.size())
+            prim = TakeSpare(spareMeshes, spareHashes.meshes, i, hashes.meshes[i]);
+        if (prim && prim->GetMaterial() != materials[m->mMaterialIndex])
+            prim.reset();
+        if (!prim) prim = ReadMesh(m);
+        meshes.push_back(prim);
+
+        // If the aiMesh has bones, associate it with its MeshPtr
+        if( m->HasBones() ){
+            meshMap[m] = prim;
         }
+    }
+}
 
-        // read vertices
-        unsigned int num = m->mNumVertices;
-        aiVector3D* src = m->mVertices;
-        float* dest = new float[3 * num];
-        for (j = 0; j < num; ++j) {
-            dest[3*j]   = src[j].x;
-            dest[3*j+1] = src[j].y;
-            dest[3*j+2] = src[j].z;
+MeshPtr AssimpResource::ReadMesh(aiMesh* m) {
+    unsigned int j;
+    //cout << "MeshName:   " << m->mName.data << endl;
+    //cout << "numBones:   " << m->mNumBones << endl; 
+    for(unsigned int b=0; b<m->mNumBones; b++){
+        aiBone* bone = m->mBones[b];
+        //cout << "   bone: " << b << endl;
+        //cout << "   numWeights: " << bone->mNumWeights << endl;
+        //cout << "   [";
+        for(unsigned int v=0; v<bone->mNumWeights; v++){
+            //cout << bone->mWeights[v].mVertexId << ", ";
         }
-        Float3DataBlockPtr pos = Float3DataBlockPtr(new DataBlock<3,float>(num, dest));
-        Float3DataBlockPtr norm;
-        if (m->HasNormals()) {
-            // read normals
-            src = m->mNormals;
-            dest = new float[3 * num];
-            for (j = 0; j < num; ++j) {
-                dest[j*3]   = src[j].x;
-                dest[j*3+1] = src[j].y;
-                dest[j*3+2] = src[j].z;
-            }
-            norm = Float3DataBlockPtr(new DataBlock<3,float>(num, dest));
+        //cout << "]" << endl;
+    }
+
+    // read vertices
+    unsigned int num = m->mNumVertices;
+    aiVector3D* src = m->mVertices;
+    float* dest = new float[3 * num];
+    for (j = 0; j < num; ++j) {
+        dest[3*j]   = src[j].x;
+        dest[3*j+1] = src[j].y;
+        dest[3*j+2] = src[j].z;
+    }
+    Float3DataBlockPtr pos = Float3DataBlockPtr(new DataBlock<3,float>(num, dest));
+    Float3DataBlockPtr norm;
+    if (m->HasNormals()) {
+        // read normals
+        src = m->mNormals;
+        dest = new float[3 * num];
+        for (j = 0; j < num; ++j) {
+            dest[j*3]   = src[j].x;
+            dest[j*3+1] = src[j].y;
+            dest[j*3+2] = src[j].z;
         }
+        norm = Float3DataBlockPtr(new DataBlock<3,float>(num, dest));
+    }
 
-        IDataBlockList texc;
-        //logger.info << "numUV: " << m->GetNumUVChannels() << logger.end;
-        for (j = 0; j < m->GetNumUVChannels(); ++j) {
-            // read texture coordinates
-            unsigned int dim = m->mNumUVComponents[j];
-            //logger.info << "numUVComponents: " << dim << logger.end;
-            src = m->mTextureCoords[j];
-            dest = new float[dim * num];
-            for (unsigned int k = 0; k < num; ++k) {
-                for (unsigned int l = 0; l < dim; ++l) {
-                    // dest[k*dim]   = src[k].x;
-                    // dest[k*dim+1] = src[k].y;
-                    // dest[k*dim+2] = src[k].z;
-                     dest[k*dim+l] = src[k][l];
-                }
-                    //logger.info << "texc: (" << src[k].x << ", " << src[k].y << ")" << logger.end; 
+    IDataBlockList texc;
+    //logger.info << "numUV: " << m->GetNumUVChannels() << logger.end;
+    for (j = 0; j < m->GetNumUVChannels(); ++j) {
+        // read texture coordinates
+        unsigned int dim = m->mNumUVComponents[j];
+        //logger.info << "numUVComponents: " << dim << logger.end;
+        src = m->mTextureCoords[j];
+        dest = new float[dim * num];
+        for (unsigned int k = 0; k < num; ++k) {
+            for (unsigned int l = 0; l < dim; ++l) {
+                // dest[k*dim]   = src[k].x;
+                // dest[k*dim+1] = src[k].y;
+                // dest[k*dim+2] = src[k].z;
+                 dest[k*dim+l] = src[k][l];
             }
-            switch (dim) {
-            case 2:
-                texc.push_back(Float2DataBlockPtr(new DataBlock<2,float>(num, dest)));
-                break;
-            case 3:
-                texc.push_back(Float3DataBlockPtr(new DataBlock<3,float>(num, dest)));
-                break;
-            default: 
-                delete dest;
-                Warning("Unsupported texture coordinate dimension");
-            };
+                //logger.info << "texc: (" << src[k].x << ", " << src[k].y << ")" << logger.end; 
         }
+        switch (dim) {
+        case 2:
+            texc.push_back(Float2DataBlockPtr(new DataBlock<2,float>(num, dest)));
+            break;
+        case 3:
+            texc.push_back(Float3DataBlockPtr(new DataBlock<3,float>(num, dest)));
+            break;
+        default: 
+            delete dest;
+            Warning("Unsupported texture coordinate dimension");
+        };
+    }
 
-        Float3DataBlockPtr col;
-        if (m->GetNumColorChannels() > 0) {
-            aiColor4D* c = m->mColors[0];
-            dest = new float[3 * num];
-            for (j = 0; j < num; ++j) {
-                dest[j*3]   = c[j].r;
-                dest[j*3+1] = c[j].g;
-                dest[j*3+2] = c[j].b;
-            }
-            col = Float3DataBlockPtr(new DataBlock<3,float>(num, dest));
+    Float3DataBlockPtr col;
+    if (m->GetNumColorChannels() > 0) {
+        aiColor4D* c = m->mColors[0];
+        dest = new float[3 * num];
+        for (j = 0; j < num; ++j) {
+            dest[j*3]   = c[j].r;
+            dest[j*3+1] = c[j].g;
+            dest[j*3+2] = c[j].b;
         }
-        //logger.info << "NumFaces: " << m->mNumFaces << logger.end;
+        col = Float3DataBlockPtr(new DataBlock<3,float>(num, dest));
+    }
+    //logger.info << "NumFaces: " << m->mNumFaces << logger.end;
+
+    // assume that we only have triangles (see triangulate option).
+    unsigned int* indexArr = new unsigned int[m->mNumFaces * 3];
+    for (j = 0; j < m->mNumFaces; ++j) {
+        aiFace src = m->mFaces[j];
+        indexArr[j*3]   = src.mIndices[0];
+        indexArr[j*3+1] = src.mIndices[1];
+        indexArr[j*3+2] = src.mIndices[2];
+    }
+    IndicesPtr index = IndicesPtr(new Indices(m->mNumFaces*3, indexArr));
 
-        // assume that we only have triangles (see triangulate option).
-        unsigned int* indexArr = new unsigned int[m->mNumFaces * 3];
+
+    IDataBlockPtr index2; // support index buffers less than 32 bit
+    // assume that we only have triangles (see triangulate option).
+    if (m->mNumVertices < 0xFF) {
+        unsigned char* indices8 = new unsigned char[m->mNumFaces * 3];
         for (j = 0; j < m->mNumFaces; ++j) {
             aiFace src = m->mFaces[j];
-            indexArr[j*3]   = src.mIndices[0];
-            indexArr[j*3+1] = src.mIndices[1];
-            indexArr[j*3+2] = src.mIndices[2];
+            indices8[j*3]   = src.mIndices[0];
+            indices8[j*3+1] = src.mIndices[1];
+            indices8[j*3+2] = src.mIndices[2];
         }
-        IndicesPtr index = IndicesPtr(new Indices(m->mNumFaces*3, indexArr));
-
-
-        IDataBlockPtr index2; // support index buffers less than 32 bit
-        // assume that we only have triangles (see triangulate option).
-        if (m->mNumVertices < 0xFF) {
-            unsigned char* indices8 = new unsigned char[m->mNumFaces * 3];
-            for (j = 0; j < m->mNumFaces; ++j) {
-                aiFace src = m->mFaces[j];
-                indices8[j*3]   = src.mIndices[0];
-                indices8[j*3+1] = src.mIndices[1];
-                indices8[j*3+2] = src.mIndices[2];
-            }
-            index2 = IDataBlockPtr(new DataBlock<1, unsigned char>(m->mNumFaces * 3, indices8, INDEX_ARRAY));
-        }
-        else if (m->mNumVertices < 0xFFFF) { 
-            unsigned short* indices16 = new unsigned short[m->mNumFaces * 3];
-            for (j = 0; j < m->mNumFaces; ++j) {
-                aiFace src = m->mFaces[j];
-                indices16[j*3]   = src.mIndices[0];
-                indices16[j*3+1] = src.mIndices[1];
-                indices16[j*3+2] = src.mIndices[2];
-            }
-            index2 = IDataBlockPtr(new DataBlock<1, unsigned short>(m->mNumFaces * 3, indices16, INDEX_ARRAY));
-        }
-        else {
-            index2 = index;
+        index2 = IDataBlockPtr(new DataBlock<1, unsigned char>(m->mNumFaces * 3, indices8, INDEX_ARRAY));
+    }
+    else if (m->mNumVertices < 0xFFFF) { 
+        unsigned short* indices16 = new unsigned short[m->mNumFaces * 3];
+        for (j = 0; j < m->mNumFaces; ++j) {
+            aiFace src = m->mFaces[j];
+            indices16[j*3]   = src.mIndices[0];
+            indices16[j*3+1] = src.mIndices[1];
+            indices16[j*3+2] = src.mIndices[2];
         }
+        index2 = IDataBlockPtr(new DataBlock<1, unsigned short>(m->mNumFaces * 3, indices16, INDEX_ARRAY));
+    }
+    else {
+        index2 = index;
+    }
 
-        GeometrySetPtr gs = GeometrySetPtr(new GeometrySet(pos, norm, texc, col));
-
-        Float3DataBlockPtr tans;
-        Float3DataBlockPtr bitans;
-        if (m->HasTangentsAndBitangents()) {
-            // logger.info << "reading tangents and bitangents." << logger.end;
-            // read tangents
-            src = m->mTangents;
-            dest = new float[3 * num];
-            for (j = 0; j < num; ++j) {
-                dest[j*3]   = src[j].x;
-                dest[j*3+1] = src[j].y;
-                dest[j*3+2] = src[j].z;
-            }
-            tans = Float3DataBlockPtr(new DataBlock<3,float>(num, dest));
-
-            // read bitangents
-            src = m->mBitangents;
-            dest = new float[3 * num];
-            for (j = 0; j < num; ++j) {
-                dest[j*3]   = src[j].x;
-                dest[j*3+1] = src[j].y;
-                dest[j*3+2] = src[j].z;
-            }
-            bitans = Float3DataBlockPtr(new DataBlock<3,float>(num, dest));
+    GeometrySetPtr gs = GeometrySetPtr(new GeometrySet(pos, norm, texc, col));
 
-            gs->AddAttributeList("tangent", tans);
-            gs->AddAttributeList("bitangent", bitans);
+    Float3DataBlockPtr tans;
+    Float3DataBlockPtr bitans;
+    if (m->HasTangentsAndBitangents()) {
+        // logger.info << "reading tangents and bitangents." << logger.end;
+        // read tangents
+        src = m->mTangents;
+        dest = new float[3 * num];
+        for (j = 0; j < num; ++j) {
+            dest[j*3]   = src[j].x;
+            dest[j*3+1] = src[j].y;
+            dest[j*3+2] = src[j].z;
         }
+        tans = Float3DataBlockPtr(new DataBlock<3,float>(num, dest));
 
-        MeshPtr prim = MeshPtr(new Mesh(index, TRIANGLES, gs, materials[m->mMaterialIndex])); 
-        prim->indices = index2; // hack to enable indices of element size smaller than 4 bytes
-
-        meshes.push_back(prim);
-
-        // If the aiMesh has bones, associate it with its MeshPtr
-        if( m->HasBones() ){
-            meshMap[m] = prim;
+        // read bitangents
+        src = m->mBitangents;
+        dest = new float[3 * num];
+        for (j = 0; j < num; ++j) {
+            dest[j*3]   = src[j].x;
+            dest[j*3+1] = src[j].y;
+            dest[j*3+2] = src[j].z;
         }
+        bitans = Float3DataBlockPtr(new DataBlock<3,float>(num, dest));
+
+        gs->AddAttributeList("tangent", tans);
+        gs->AddAttributeList("bitangent", bitans);
     }
+
+    MeshPtr prim = MeshPtr(new Mesh(index, TRIANGLES, gs, materials[m->mMaterialIndex])); 
+    prim->indices = index2; // hack to enable indices of element size smaller than 4 bytes
+    return prim;
 }
 
 inline void ReadTextures(aiTextureType type, string name, aiMaterial* m, MaterialPtr mat, string dir) {
@@ -333,68 +1061,80 @@ void AssimpResource::ReadMaterials(aiMaterial** ms, unsigned int size) {
     // logger.info << "NumMaterials: " << size << logger.end;
     unsigned int i;
     for (i = 0; i < size; ++i) {
-        aiMaterial* m = ms[i];
-        aiString s;
-        std::string name = "Default";
-        if (AI_SUCCESS == m->Get(AI_MATKEY_NAME, s))
-            name = string(s.data);
-        
-        MaterialPtr mat = MaterialPtr(new Material(name));
-
-        //logger.info << "mat name: " << mat->GetName() << logger.end;
-
-        int shade;
-        if (AI_SUCCESS == m->Get(AI_MATKEY_SHADING_MODEL, shade)) { 
-            switch (shade) {
-            case aiShadingMode_Gouraud:
-                // logger.info << "use gouraud shader" << logger.end;
-                break;
-            case aiShadingMode_Phong:
-                mat->shading = Material::PHONG;
-                // logger.info << "use phong shader" << logger.end;
-                break;
-            case aiShadingMode_Blinn:
-                mat->shading = Material::BLINN;
-                // logger.info << "use blinn shader" << logger.end;
-                break;
-            default:
-                mat->shading = Material::NONE;
-                // logger.info << "no shader found" << logger.end;
-            }
+        MaterialPtr mat;
+        if (i < hashes.materials.size())
+            mat = TakeSpare(spareMaterials, spareHashes.materials, i, hashes.materials[i]);
+        if (!mat && i < spareMaterials.size() && spareMaterials[i]) {
+            // Update the material in place so meshes using it can be kept.
+            mat = spareMaterials[i];
+            spareMaterials[i].reset();
+            *mat = *ReadMaterial(ms[i]);
         }
+        if (!mat) mat = ReadMaterial(ms[i]);
+        materials.push_back(mat);
+    }
+}
 
-        aiColor3D c;
-        if (AI_SUCCESS == m->Get(AI_MATKEY_COLOR_DIFFUSE, c)) 
-            mat->diffuse = Vector<4,float>(c.r, c.g, c.b, 1.0);
-        if (AI_SUCCESS == m->Get(AI_MATKEY_COLOR_SPECULAR, c)) 
-            mat->specular = Vector<4,float>(c.r, c.g, c.b, 1.0);
-        if (AI_SUCCESS == m->Get(AI_MATKEY_COLOR_AMBIENT, c)) 
-            mat->ambient = Vector<4,float>(c.r, c.g, c.b, 1.0);
-        if (AI_SUCCESS == m->Get(AI_MATKEY_COLOR_EMISSIVE, c)) 
-            mat->emission = Vector<4,float>(c.r, c.g, c.b, 1.0);
-        if (AI_SUCCESS == m->Get(AI_MATKEY_COLOR_TRANSPARENT, c)) {
-            mat->transparency = (c.r + c.g + c.b) / 3.0;
-            if (mat->transparency == 1.0) {
-                mat->transparency = 0.0;
-                logger.info << "Ignoring silly transparency value of 1.0 in file: " << file << logger.end;
-            }
-            // logger.info << "transparency: " << mat->transparency << logger.end; 
+MaterialPtr AssimpResource::ReadMaterial(aiMaterial* m) {
+    aiString s;
+    std::string name = "Default";
+    if (AI_SUCCESS == m->Get(AI_MATKEY_NAME, s))
+        name = string(s.data);
+    
+    MaterialPtr mat = MaterialPtr(new Material(name));
+
+    //logger.info << "mat name: " << mat->GetName() << logger.end;
+
+    int shade;
+    if (AI_SUCCESS == m->Get(AI_MATKEY_SHADING_MODEL, shade)) { 
+        switch (shade) {
+        case aiShadingMode_Gouraud:
+            // logger.info << "use gouraud shader" << logger.end;
+            break;
+        case aiShadingMode_Phong:
+            mat->shading = Material::PHONG;
+            // logger.info << "use phong shader" << logger.end;
+            break;
+        case aiShadingMode_Blinn:
+            mat->shading = Material::BLINN;
+            // logger.info << "use blinn shader" << logger.end;
+            break;
+        default:
+            mat->shading = Material::NONE;
+            // logger.info << "no shader found" << logger.end;
         }
-        float tmp;
-        if (AI_SUCCESS == m->Get(AI_MATKEY_SHININESS, tmp) && tmp >= 0.0f && tmp <= 128.0f)
-            mat->shininess = tmp;
-
-        
-        ReadTextures(aiTextureType_AMBIENT, "ambient", m, mat, dir);
-        ReadTextures(aiTextureType_DIFFUSE, "diffuse", m, mat, dir);
-        ReadTextures(aiTextureType_SPECULAR, "specular", m, mat, dir);
-        ReadTextures(aiTextureType_EMISSIVE, "emissive", m, mat, dir);
-        ReadTextures(aiTextureType_NORMALS, "normals", m, mat, dir);
-        ReadTextures(aiTextureType_HEIGHT, "height", m, mat, dir);
-        ReadTextures(aiTextureType_OPACITY, "opacity", m, mat, dir);
+    }
 
-        materials.push_back(mat);
+    aiColor3D c;
+    if (AI_SUCCESS == m->Get(AI_MATKEY_COLOR_DIFFUSE, c)) 
+        mat->diffuse = Vector<4,float>(c.r, c.g, c.b, 1.0);
+    if (AI_SUCCESS == m->Get(AI_MATKEY_COLOR_SPECULAR, c)) 
+        mat->specular = Vector<4,float>(c.r, c.g, c.b, 1.0);
+    if (AI_SUCCESS == m->Get(AI_MATKEY_COLOR_AMBIENT, c)) 
+        mat->ambient = Vector<4,float>(c.r, c.g, c.b, 1.0);
+    if (AI_SUCCESS == m->Get(AI_MATKEY_COLOR_EMISSIVE, c)) 
+        mat->emission = Vector<4,float>(c.r, c.g, c.b, 1.0);
+    if (AI_SUCCESS == m->Get(AI_MATKEY_COLOR_TRANSPARENT, c)) {
+        mat->transparency = (c.r + c.g + c.b) / 3.0;
+        if (mat->transparency == 1.0) {
+            mat->transparency = 0.0;
+            logger.info << "Ignoring silly transparency value of 1.0 in file: " << file << logger.end;
+        }
+        // logger.info << "transparency: " << mat->transparency << logger.end; 
     }
+    float tmp;
+    if (AI_SUCCESS == m->Get(AI_MATKEY_SHININESS, tmp) && tmp >= 0.0f && tmp <= 128.0f)
+        mat->shininess = tmp;
+
+    
+    ReadTextures(aiTextureType_AMBIENT, "ambient", m, mat, dir);
+    ReadTextures(aiTextureType_DIFFUSE, "diffuse", m, mat, dir);
+    ReadTextures(aiTextureType_SPECULAR, "specular", m, mat, dir);
+    ReadTextures(aiTextureType_EMISSIVE, "emissive", m, mat, dir);
+    ReadTextures(aiTextureType_NORMALS, "normals", m, mat, dir);
+    ReadTextures(aiTextureType_HEIGHT, "height", m, mat, dir);
+    ReadTextures(aiTextureType_OPACITY, "opacity", m, mat, dir);
+    return mat;
 }
     
 void AssimpResource::ReadScene(const aiScene* scene) {
@@ -409,13 +1149,10 @@ void AssimpResource::ReadScene(const aiScene* scene) {
     // }
 }
 
-void AssimpResource::ReadNode(aiNode* node, ISceneNode* parent) {
-
-    unsigned int i;
-    ISceneNode* current = parent;
-    aiMatrix4x4 t = node->mTransformation;
-
-    // If the node holds any mesh we create a parent transformation node for the mesh.
+/**
+ * Set the transformation node to the decomposition of an Assimp matrix.
+ */
+inline void ReadTransformation(aiMatrix4x4 t, TransformationNode* tn) {
     aiVector3D pos, scl;
     aiQuaternion rot;
     // NOTE: decompose seems buggy when it comes to rotations
@@ -431,14 +1168,33 @@ void AssimpResource::ReadNode(aiNode* node, ISceneNode* parent) {
                                                               m3.a2, m3.b2, m3.c2,  
                                                               m3.a3, m3.b3, m3.c3));
 
-    // Create parent transformation node.
-    TransformationNode* tn = new TransformationNode();
     tn->SetPosition(Vector<3,float>(pos.x, pos.y, pos.z));
     tn->SetScale(Vector<3,float>(scl.x, scl.y, scl.z));
     tn->SetRotation(q);
     //tn->SetRotation(Quaternion<float>(rot.w, Vector<3,float>(rot.x, rot.y, rot.z)));
     //        tn->SetRotation(rot);
+}
+
+void AssimpResource::ReadNode(aiNode* node, ISceneNode* parent) {
 
+    unsigned int i;
+    ISceneNode* current = parent;
+
+    // Create parent transformation node, or reuse the one of the same
+    // name from the previous scene.
+    TransformationNode* tn = NULL;
+    map<string, TransformationNode*>::iterator spare = spareTrans.find(node->mName.data);
+    if (spare != spareTrans.end()) {
+        tn = spare->second;
+        spareTrans.erase(spare);
+    }
+    else tn = new TransformationNode();
+    ReadTransformation(node->mTransformation, tn);
+    unsigned int index = nodeTrans.size();
+    nodeTrans.push_back(tn);
+    nodeParents.push_back(current);
+    nodeScenes.push_back(NULL);
+    nodeNames.push_back(node->mName.data);
         
     current->AddNode(tn);
     current = tn;
@@ -453,11 +1209,13 @@ void AssimpResource::ReadNode(aiNode* node, ISceneNode* parent) {
             string name = meshNode->GetInfo();
             meshNode->SetInfo(name.append(buf));
             scene->AddNode(meshNode);
+            meshNodes[node->mMeshes[i]].push_back(meshNode);
         } 
         scene->SetInfo(node->mName.data);
         //cout << "Adding scenenode with name: " << node->mName.data << " with " << node->mNumMeshes << " number of meshes" << endl;
         current->AddNode(scene);
         current = scene;
+        nodeScenes[index] = scene;
 
         // Associate node name with the transformation node we just created.
         if( transMap.find(node->mName.data) == transMap.end() ){
@@ -473,6 +1231,46 @@ void AssimpResource::ReadNode(aiNode* node, ISceneNode* parent) {
     }
 }
 
+/**
+ * Take the transformation nodes out of the scene. Nodes with a unique
+ * name are set aside for a rebuild to reuse, the rest are deleted
+ * along with the mesh nodes.
+ */
+void AssimpResource::ReleaseNodes() {
+    unsigned int i;
+    map<string, unsigned int> count;
+    for (i = 0; i < nodeNames.size(); ++i)
+        ++count[nodeNames[i]];
+    // parents are visited before their children, so detach all nodes
+    // before the mesh nodes holders that may be their parents go.
+    for (i = 0; i < nodeTrans.size(); ++i)
+        nodeParents[i]->RemoveNode(nodeTrans[i]);
+    for (i = 0; i < nodeTrans.size(); ++i) {
+        if (nodeScenes[i]) {
+            nodeTrans[i]->RemoveNode(nodeScenes[i]);
+            delete nodeScenes[i];
+        }
+        if (count[nodeNames[i]] == 1) spareTrans[nodeNames[i]] = nodeTrans[i];
+        else delete nodeTrans[i];
+    }
+    nodeTrans.clear();
+    nodeParents.clear();
+    nodeScenes.clear();
+    nodeNames.clear();
+    meshNodes.clear();
+}
+
+/**
+ * Update the transformations of an unchanged hierarchy. Nodes are
+ * visited in the same order as ReadNode created them.
+ */
+void AssimpResource::PatchNode(aiNode* node, unsigned int& index) {
+    ReadTransformation(node->mTransformation, nodeTrans[index++]);
+    for (unsigned int i = 0; i < node->mNumChildren; ++i) {
+        PatchNode(node->mChildren[i], index);
+    }
+}
+
 
     void AssimpResource::ReadAnimations(aiAnimation** ani, unsigned int size) {
 
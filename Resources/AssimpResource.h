@@ -19,6 +19,9 @@
 #include <Geometry/Material.h>
 #include <Geometry/GeometrySet.h>
 #include <Resources/DataBlock.h>
+#include <Resources/AssimpCollisionProxy.h>
+#include <Core/IListener.h>
+#include <Core/IModule.h>
 
 #include <Math/Vector.h>
 
@@ -41,18 +44,83 @@ namespace OpenEngine {
 namespace Resources {
     class ITexture2D;
     typedef boost::shared_ptr<ITexture2D> ITexture2DPtr;
+    class AssimpImportThread;
 
     using namespace Geometry;
     using std::string;
     using std::vector;
     
 
+/**
+ * Timings and sizes of the last load of an AssimpResource. Times are
+ * in microseconds.
+ */
+struct AssimpLoadStatistics {
+    unsigned int importTime, hashTime, materialTime, meshTime, sceneTime;
+    unsigned int animationTime, animatedMeshTime, collisionTime;
+    unsigned int numMeshes, numVertices, numFaces;
+    unsigned int numMaterials, numNodes, numKeys;
+
+    AssimpLoadStatistics()
+        : importTime(0), hashTime(0), materialTime(0), meshTime(0), sceneTime(0)
+        , animationTime(0), animatedMeshTime(0), collisionTime(0)
+        , numMeshes(0), numVertices(0), numFaces(0)
+        , numMaterials(0), numNodes(0), numKeys(0) {}
+};
+
+/**
+ * Modification stamp of a watched model file. The contents are only
+ * hashed if the file was modified in the second it was stamped, as
+ * a later write in that second may leave the rest of the stamp as is.
+ */
+struct AssimpFileStamp {
+    long mtime, nsec;
+    unsigned long size;
+    unsigned int hash;
+
+    AssimpFileStamp(): mtime(0), nsec(0), size(0), hash(0) {}
+};
+
+/**
+ * Hashes of an imported scene, used to diff a reloaded scene against
+ * the current one.
+ */
+struct AssimpSceneHashes {
+    vector<unsigned int> meshes, materials;
+    // node hierarchy without transformations, and animation channels.
+    // structure is zero if the scene was not hashed.
+    unsigned int structure, animation;
+
+    AssimpSceneHashes(): structure(0), animation(0) {}
+};
+
 /**
  * Assimp model resource.
  *
+ * When watched (see Watch()) the resource polls the model file on
+ * each process event. A modified file is re-imported on a background
+ * thread and the new scene is diffed against the current one: changed
+ * transformations, materials and meshes are patched in place while
+ * unchanged meshes (and their uploaded geometry sets) are kept. This
+ * also holds for animated scenes as long as the animations and the
+ * skinned meshes are unchanged. Otherwise, or if the node hierarchy or
+ * the number of meshes or materials changed, the node and animation
+ * graph is rebuilt. The rebuild keeps the unchanged materials and
+ * meshes, and the transformation nodes by name.
+ *
+ * The scene is only hashed for diffing when loaded if it is watched or
+ * has collision proxies. Otherwise it is hashed by a background import
+ * when it is first watched.
+ *
+ * Collision proxies are generated on worker threads while the scene
+ * is built if enabled with SetCollisionOptions() before loading. On a
+ * reload only the proxies of changed meshes are rebuilt, on the import
+ * thread.
+ *
  * @class AssimpResource AssimpResource.h "AssimpResource.h"
  */
-class AssimpResource : public IModelResource {
+class AssimpResource : public IModelResource
+                     , public Core::IListener<Core::ProcessEventArg> {
 private: 
     string file, dir;
     ISceneNode* root;
@@ -64,17 +132,57 @@ private:
     map<std::string, OpenEngine::Scene::TransformationNode*> transMap;
     map<aiMesh*, OpenEngine::Geometry::MeshPtr> meshMap;
 
+    // state used to diff a reloaded scene against the current one.
+    AssimpSceneHashes hashes;
+    vector<vector<MeshNode*> > meshNodes; // mesh nodes by mesh index
+    vector<TransformationNode*> nodeTrans; // in scene traversal order
+    vector<ISceneNode*> nodeParents; // parent of each transformation node
+    vector<ISceneNode*> nodeScenes; // mesh nodes holder of each, or NULL
+    vector<string> nodeNames;
+
+    // parts of the previous scene a rebuild may reuse.
+    vector<MeshPtr> spareMeshes;
+    vector<MaterialPtr> spareMaterials;
+    AssimpSceneHashes spareHashes;
+    map<string, TransformationNode*> spareTrans;
+
+    // file watching
+    bool watch;
+    AssimpFileStamp stamp;
+    unsigned int pollInterval, sincePoll;
+    AssimpImportThread* reloader;
+    bool reloadPending;
+
+    CollisionOptions collisionOptions;
+    CollisionProxyList collisionProxies;
+    unsigned int proxyOptions; // options hash of the proxies, zero if none
+
+    AssimpLoadStatistics stats;
+
     void Error(string msg);
     void Warning(string msg);
 
     void ReadMeshes(aiMesh** ms, unsigned int size);
+    MeshPtr ReadMesh(aiMesh* m);
     void ReadMaterials(aiMaterial** ms, unsigned int size);
+    MaterialPtr ReadMaterial(aiMaterial* m);
     void ReadScene(const aiScene* scene);
     void ReadNode(aiNode* node, ISceneNode* parent);
 
     void ReadAnimations(aiAnimation** ani, unsigned int size);
     void ReadAnimatedMeshes(aiMesh** ms, unsigned int size);
 
+    void BuildScene(const aiScene* scene, bool rebuild = false);
+    void PatchScene(const aiScene* scene, AssimpSceneHashes& newHashes);
+    void PatchNode(aiNode* node, unsigned int& index);
+    void ReleaseNodes();
+
+    CollisionProxyBuilder* StartCollisionProxies(const aiScene* scene);
+    void FinishCollisionProxies(CollisionProxyBuilder* builder);
+    void UpdateCollisionProxies(AssimpImportThread* reloader);
+    void SaveCollisionProxies(CollisionProxyList& built, CollisionOptions& options);
+    void LinkCollisionProxies(CollisionOptions::Granularity granularity);
+
 public:
     AssimpResource(string file);
     ~AssimpResource();
@@ -82,17 +190,34 @@ public:
     void Unload();
     ISceneNode* GetSceneNode();
 
+    void Watch(bool enable, unsigned int interval = 500000);
+    bool IsWatched();
+    void Reload();
+    void Handle(Core::ProcessEventArg arg);
+
+    void SetCollisionOptions(CollisionOptions options);
+    CollisionOptions GetCollisionOptions();
+    CollisionProxyList GetCollisionProxies();
+
+    AssimpLoadStatistics GetLoadStatistics();
 };
 
 /**
  * Assimp resource plug-in.
  *
+ * PLY point clouds of at least the stream threshold size (64 MB by
+ * default) are loaded by the AssimpPLYStreamResource instead of going
+ * through the Assimp importer.
+ *
  * @class AssimpPlugin AssimpResource.h "AssimpResource.h"
  */
 class AssimpPlugin : public IResourcePlugin<IModelResource> {
+private:
+    unsigned long streamSize;
 public:
 	AssimpPlugin();
     IModelResourcePtr CreateResource(string file);
+    void SetStreamThreshold(unsigned long bytes);
 };
 
 } // NS Resources